@@ -1,6 +1,9 @@
 #include <bits/stdc++.h>
 #include <omp.h>
 #include "cxxopts.hpp"
+#include "../graph_read.hpp"
+#include "../dp_store.hpp"
+#include "../path_sampler.hpp"
 
 #define ERROR(c,s) if(c){perror(s); return -1;}
 
@@ -53,7 +56,7 @@ typedef struct graph
 
   std::vector<char> label;
   std::vector<bloom_filter> filter;
-  std::vector<std::vector<int>> edges;
+  CSRGraph edges;
   std::vector<std::multiset<int>> attributes;
   std::vector<std::string> attnames;
 
@@ -62,14 +65,13 @@ typedef struct graph
     N = n;
     label.resize(N, 0);
     filter.resize(N, bloom_filter());
-    edges.resize(N, std::vector<int>());
     attributes.resize(N, std::multiset<int>());
   };
 
-  void addEdge(int i, int j)
+  // Build the adjacency lists from the m edges (ab[2i], ab[2i+1])
+  void build(const int *ab, size_t m)
   {
-    edges[i].push_back(j);
-    edges[j].push_back(i);
+    buildCSR(edges, N, ab, m);
   };
 
 } graph;
@@ -92,6 +94,8 @@ bool all = false;
 
 std::string input = "";
 std::string output = "";
+std::string save_dp = "";
+std::string load_dp = "";
 
 int experiments = 1;
 size_t Rsize = 1000;
@@ -282,6 +286,33 @@ void processDP()
 
 }
 
+// Save the DP table to filename, keyed by graph, Q and bloom filters
+bool saveDP(const std::string &filename)
+{
+  DPHeader h = makeDPHeader(Q, G.edges, G.filter.data(), sizeof(bloom_filter),
+                            sizeof(bloom_filter), false);
+  DPFileWriter w(filename.c_str(), h, G.filter.data());
+  for(size_t i = 1; i <= Q; i++) writeMapLayer(w, dp[i].data(), N);
+  return w.close();
+}
+
+// Load the DP table saved by saveDP, if it was built for the same graph, Q
+// and bloom filters (same seed, Z and H)
+bool loadDP(const std::string &filename)
+{
+  DPFile f;
+  if(!f.open(filename.c_str())) return false;
+  if(!f.matches(Q, G.edges, G.filter.data(), sizeof(bloom_filter), sizeof(bloom_filter)))
+  {
+    fprintf(stderr, "DP file %s was built for a different graph, Q, seed, Z or H\n", filename.c_str());
+    return false;
+  }
+  dp.resize(Q+1, std::vector<std::map<bloom_filter, long long int>>(N));
+  for(size_t i = 1; i <= Q; i++)
+    if(!readMapLayer(f, dp[i].data(), N)) return false;
+  return true;
+}
+
 
 // Fcount
 bool isPrefix(dict_t& W, qpath& x) {
@@ -312,36 +343,64 @@ bool isPrefix(dict_t& W, qpath& x) {
   return found;
 }
 
-path randomPathTo(int u)
+// Steps of randomPaths, cached across the samples (the DP does not change)
+PathSampler sampler;
+
+// Weight of the step to v from a path with filter cur: dp[i][v] of the
+// filter with v added, 0 if v adds no bit
+long long int stepWeight(size_t i, int v, const bloom_filter &cur)
 {
-  path p = {u};
-  bloom_filter cur = G.filter[u];
+  bloom_filter next = cur+G.filter[v];
+  if(next == cur) return 0;
+  auto it = dp[i][v].find(next);
+  return it == dp[i][v].end() ? 0 : it->second;
+}
 
-  for(size_t i=2; i<=Q; i++)
+// Random paths from the nodes of from, built level by level: the partial
+// paths at the same step (node, filter) are drawn together from one step
+// table. A path stops early if no neighbour adds to its filter.
+std::vector<path> randomPaths(const std::vector<int> &from)
+{
+  size_t n = from.size();
+  std::vector<path> P(n);
+  std::vector<bf_t> cur(n);
+  std::vector<size_t> alive(n);
+  for(size_t s=0; s<n; s++)
   {
-    std::vector<ll> freq;
-    bool one = false;
-    for (int v : G.edges[u])
-    {
-      bool valid = !((cur+G.filter[v]) == cur);
-      freq.push_back(valid ? dp[i][v][cur+G.filter[v]] : 0);
-      one = one || valid;
-    }
-
-    if(!one) return p;
+    P[s] = {from[s]};
+    cur[s] = G.filter[from[s]].data;
+    alive[s] = s;
+  }
 
-    std::discrete_distribution<ll> distribution(freq.begin(), freq.end());
+  auto byStep = [&](size_t a, size_t b)
+  {
+    return std::make_tuple(P[a].back(), cur[a], a) < std::make_tuple(P[b].back(), cur[b], b);
+  };
 
-    int next = 0;
-    #pragma omp critical
+  for(size_t i=2; i<=Q && !alive.empty(); i++)
+  {
+    std::sort(alive.begin(), alive.end(), byStep);
+    std::vector<size_t> next;
+    for(size_t k=0; k<alive.size();)
     {
-      next = distribution(rng);
+      int u = P[alive[k]].back();
+      bloom_filter f(cur[alive[k]]);
+      const PathStep &S = sampler.step(G.edges, i, u, f.data,
+                                       [&](int v) { return stepWeight(i, v, f); });
+
+      for(; k<alive.size() && P[alive[k]].back() == u && cur[alive[k]] == f.data; k++)
+      {
+        size_t s = alive[k];
+        int v = S.sample(rng);
+        if(v < 0) continue;
+        P[s].push_back(v);
+        cur[s] |= G.filter[v].data;
+        next.push_back(s);
+      }
     }
-    u = G.edges[u][next];
-    cur = cur+G.filter[u];
-    p.push_back(u);
+    alive.swap(next);
   }
-  return p;
+  return P;
 }
 
 // Baseline
@@ -438,6 +497,8 @@ int main(int argc, char** argv) {
     (    "v,verbose", "Verbose log",                                          cxxopts::value(verbose))
     (      "i,input", "Input file name (default: stdin)",                     cxxopts::value(input))
     (     "o,output", "Output file name (default: stdout)",                   cxxopts::value(output))
+    (      "save-dp", "Save the DP table to file",                            cxxopts::value(save_dp))
+    (      "load-dp", "Load the DP table from file instead of computing it",  cxxopts::value(load_dp))
     // Algorithms to run
     (   "bruteforce", "Compute similarity with bruteforce",                   cxxopts::value(bruteforce_f))
     (       "fcount", "Compute similarity with fCount",                       cxxopts::value(fcount_f))
@@ -499,10 +560,7 @@ int main(int argc, char** argv) {
     std::cerr.rdbuf(fnull.rdbuf());
   }
 
-  // Redirect cin buffer
   input = "dataset/dblp.graph";
-  std::ifstream fin(input);
-  std::cin.rdbuf(fin.rdbuf());
 
   // Redirect cout buffer
   if (output.size() != 0) {
@@ -518,7 +576,16 @@ int main(int argc, char** argv) {
   std::cerr.precision(6);
 
   // Read input
-  std::cin >> N >> M;
+  std::vector<int> in;
+  ERROR(!readTextInts(input.c_str(), in), "Reading input");
+  ERROR(in.size() < 2, "Reading input");
+  N = in[0];
+  M = in[1];
+  if (in.size() < 2 + 2 * (size_t)M) {
+    std::cerr << "Input truncated, using the first " << (in.size() - 2) / 2
+              << " edges" << std::endl;
+    M = (in.size() - 2) / 2;
+  }
   std::cerr << "Read graph N = " << N << " M = " << M << std::endl;
 
   N++;
@@ -533,11 +600,7 @@ int main(int argc, char** argv) {
 
   // Reading nodes
   std::cerr << "Reading edges..." << std::endl;
-  for (int i = 0; i < M; i++) {
-    int a, b;
-    std::cin >> a >> b;
-    G.addEdge(a, b);
-  }
+  G.build(in.data() + 2, M);
   std::cerr << "end" << std::endl;
 
   // Create filter
@@ -548,7 +611,7 @@ int main(int argc, char** argv) {
 
   std::cerr << "Read attributes..." << std::endl;
   input = "dataset/dblp.att";
-  fin = std::ifstream(input);
+  std::ifstream fin(input);
   std::cin.rdbuf(fin.rdbuf());
   for(int i=1; i<N; i++)
   {
@@ -566,7 +629,15 @@ int main(int argc, char** argv) {
 
   // Process DP only if fcount or fsample are enabled
   std::cerr << "Start processing DP Table..." << std::endl;
-  processDP();
+  if(load_dp.size() != 0)
+  {
+    ERROR(!loadDP(load_dp), "Loading DP table");
+  }
+  else processDP();
+  if(save_dp.size() != 0)
+  {
+    ERROR(!saveDP(save_dp), "Saving DP table");
+  }
   std::cerr << "end" << std::endl;
 
   std::cerr << "Start BFS" << std::endl;
@@ -583,12 +654,12 @@ int main(int argc, char** argv) {
     limit = 10000;
     
     std::set<path> R;
-    for(size_t t=0; t<10*limit; t++)
+    for(size_t t=0; t<10*limit && R.size() < limit;)
     {
-      path toAdd = randomPathTo(i);
-      if(toAdd.size() < Q) continue;
-      R.insert(toAdd);
-      if(R.size() == limit) break;
+      size_t batch = std::min(limit - R.size(), 10*limit - t);
+      for(const path &toAdd : randomPaths(std::vector<int>(batch, i)))
+        if(toAdd.size() == Q) R.insert(toAdd);
+      t += batch;
     }
     
     sampledFingerprint[i] = fingerprint(std::vector<path>(R.begin(), R.end()));
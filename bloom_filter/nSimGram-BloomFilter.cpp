@@ -1,15 +1,20 @@
 #include <bits/stdc++.h>
 #include <omp.h>
 #include "cxxopts.hpp"
+#include "../graph_read.hpp"
+#include "../dp_store.hpp"
+#include "../path_sampler.hpp"
+#include "../query_server.hpp"
+#include "../qgram.hpp"
 
 #define ERROR(c,s) if(c){perror(s); return -1;}
 
 typedef uint64_t bf_t;
 typedef uint64_t ll;
 typedef std::vector<int> path;
-typedef std::string qpath;
-typedef std::set<qpath> dict_t;     // dictionary of string (q-paths)
-typedef std::map<qpath, ll> fdict_t;// frequency dictionary of string (q-paths)
+typedef QGram qpath;                // labels of a q-path, packed (qgram.hpp)
+typedef QGramSet dict_t;            // dictionary of q-paths
+typedef QGramCount fdict_t;         // frequency dictionary of q-paths
 
 typedef struct bloom_filter
 {
@@ -53,20 +58,19 @@ typedef struct graph
 
   std::vector<char> label;
   std::vector<bloom_filter> filter;
-  std::vector<std::vector<int>> edges;
+  CSRGraph edges;
 
   graph(int n)
   {
     N = n;
     label.resize(N, 0);
     filter.resize(N, bloom_filter());
-    edges.resize(N, std::vector<int>());
   };
 
-  void addEdge(int i, int j)
+  // Build the adjacency lists from the m edges (ab[2i], ab[2i+1])
+  void build(const int *ab, size_t m)
   {
-    edges[i].push_back(j);
-    edges[j].push_back(i);
+    buildCSR(edges, N, ab, m);
   };
 
 } graph;
@@ -86,9 +90,13 @@ bool fcount_f = false;
 bool fsample_f = false;
 bool baseline_f = false;
 bool all = false;
+bool serve = false;
 
 std::string input = "";
 std::string output = "";
+std::string save_dp = "";
+std::string load_dp = "";
+std::string socket_path = "";
 
 int experiments = 1;
 size_t Rsize = 1000;
@@ -97,6 +105,9 @@ int Nthreads = -1;
 bool first = true;
 bool sort = true;
 
+const char labelBase = '0' + 33;    // G.label of the label 0
+unsigned int labelBits = 1;         // bits per label in a qpath
+
 size_t Q = 4;
 int A = -1;
 int B = -1;
@@ -139,14 +150,19 @@ double fjw(const dict_t& W, fdict_t& freqA, fdict_t& freqB, ll R) {
   return static_cast<double>(num) / static_cast<double>(R);
 }
 
+// Number of labels in the qpath of a path of n nodes
+size_t qlen(size_t n) { return first ? n-1 : n; }
+
 // path -> qpath
 qpath L(const path& p)
 {
-  qpath out;
-  out.reserve(p.size());
-  for(int v : p) out += G.label[v];
-  if(first) out = out.substr(1);
-  if(sort) std::sort(out.begin(), out.end());
+  unsigned int s[8 * sizeof(qpath)];
+  size_t n = 0;
+  for(size_t i = first ? 1 : 0; i < p.size(); i++)
+    s[n++] = (unsigned char)(G.label[p[i]] - labelBase);
+  if(sort) std::sort(s, s+n);
+  qpath out = 0;
+  for(size_t i = 0; i < n; i++) out = qgramPush(out, s[i], labelBits);
   return out;
 }
 
@@ -258,61 +274,131 @@ void processDP()
 
 }
 
+// Save the DP table to filename, keyed by graph, Q and bloom filters
+bool saveDP(const std::string &filename)
+{
+  DPHeader h = makeDPHeader(Q, G.edges, G.filter.data(), sizeof(bloom_filter),
+                            sizeof(bloom_filter), false);
+  DPFileWriter w(filename.c_str(), h, G.filter.data());
+  for(size_t i = 1; i <= Q; i++) writeMapLayer(w, dp[i].data(), N);
+  return w.close();
+}
 
-// Fcount
-bool isPrefix(dict_t& W, qpath& x) {
-
-  if(!sort)
+// Load the DP table saved by saveDP, if it was built for the same graph, Q
+// and bloom filters (same seed, Z and H)
+bool loadDP(const std::string &filename)
+{
+  DPFile f;
+  if(!f.open(filename.c_str())) return false;
+  if(!f.matches(Q, G.edges, G.filter.data(), sizeof(bloom_filter), sizeof(bloom_filter)))
   {
-    auto it = W.lower_bound(x);
-    if (it == W.end()) return false;
-    else return std::mismatch(x.begin(), x.end(), (*it).begin()).first == x.end();
+    fprintf(stderr, "DP file %s was built for a different graph, Q, seed, Z or H\n", filename.c_str());
+    return false;
   }
+  dp.resize(Q+1, std::vector<std::map<bloom_filter, long long int>>(N));
+  for(size_t i = 1; i <= Q; i++)
+    if(!readMapLayer(f, dp[i].data(), N)) return false;
+  return true;
+}
+
 
+// Fcount
+// Prefixes of the qpaths of W, by length
+std::vector<dict_t> prefixes(const dict_t& W)
+{
+  size_t n = qlen(Q);
+  std::vector<dict_t> pre(n+1);
+  for(qpath w : W)
+    for(size_t l = n+1; l-- > 0; w = qgramPop(w, labelBits)) pre[l].insert(w);
+  return pre;
+}
+
+// The qpath x of len labels is a prefix of a qpath of W (or, with sort, a
+// subset of one); pre = prefixes(W)
+bool isPrefix(const dict_t& W, const std::vector<dict_t>& pre, qpath x, size_t len) {
+
+  if(!sort) return pre[len].count(x) > 0;
+
+  size_t n = qlen(Q);
   bool found = false;
-  for(const qpath &q : W)
+  for(qpath q : W)
   {
     size_t l=0;
     size_t r=0;
-    while(l < q.size() && r < x.size())
+    while(l < n && r < len)
     {
-      if(q[l] == x[r]) l++, r++;
-      else if(q[l] < x[r]) l++;
+      unsigned int ql = qgramAt(q, l, n, labelBits);
+      unsigned int xr = qgramAt(x, r, len, labelBits);
+      if(ql == xr) l++, r++;
+      else if(ql < xr) l++;
       else break;
     }
 
-    found = (r == x.size());
-   	if(found) break;
+    found = (r == len);
+    if(found) break;
   }
 
   return found;
 }
 
-path randomPathTo(int u)
+// Steps of randomPaths, cached across the samples (the DP does not change)
+PathSampler sampler;
+
+// Weight of the step to v from a path with filter cur: dp[i][v] of the
+// filter with v added, 0 if v adds no bit
+long long int stepWeight(size_t i, int v, const bloom_filter &cur)
 {
-  path p = {u};
-  bloom_filter cur = G.filter[u];
+  bloom_filter next = cur+G.filter[v];
+  if(next == cur) return 0;
+  auto it = dp[i][v].find(next);
+  return it == dp[i][v].end() ? 0 : it->second;
+}
 
-  for(size_t i=2; i<=Q; i++)
+// Random paths from the nodes of from, built level by level: the partial
+// paths at the same step (node, filter) are drawn together from one step
+// table. A path stops early if no neighbour adds to its filter.
+std::vector<path> randomPaths(const std::vector<int> &from)
+{
+  size_t n = from.size();
+  std::vector<path> P(n);
+  std::vector<bf_t> cur(n);
+  std::vector<size_t> alive(n);
+  for(size_t s=0; s<n; s++)
   {
-    std::vector<ll> freq;
-    bool one = false;
-    for (int v : G.edges[u])
-    {
-      bool valid = !((cur+G.filter[v]) == cur);
-      freq.push_back(valid ? dp[i][v][cur+G.filter[v]] : 0);
-      one = one || valid;
-    }
+    P[s] = {from[s]};
+    cur[s] = G.filter[from[s]].data;
+    alive[s] = s;
+  }
 
-    if(!one) return p;
+  auto byStep = [&](size_t a, size_t b)
+  {
+    return std::make_tuple(P[a].back(), cur[a], a) < std::make_tuple(P[b].back(), cur[b], b);
+  };
 
-    std::discrete_distribution<ll> distribution(freq.begin(), freq.end());
+  for(size_t i=2; i<=Q && !alive.empty(); i++)
+  {
+    std::sort(alive.begin(), alive.end(), byStep);
+    std::vector<size_t> next;
+    for(size_t k=0; k<alive.size();)
+    {
+      int u = P[alive[k]].back();
+      bloom_filter f(cur[alive[k]]);
+      const PathStep &S = sampler.step(G.edges, i, u, f.data,
+                                       [&](int v) { return stepWeight(i, v, f); });
 
-    u = G.edges[u][distribution(rng)];
-    cur = cur+G.filter[u];
-    p.push_back(u);
+      for(; k<alive.size() && P[alive[k]].back() == u && cur[alive[k]] == f.data; k++)
+      {
+        size_t s = alive[k];
+        int v = S.sample(rng);
+        if(v < 0) continue;
+        P[s].push_back(v);
+        cur[s] |= G.filter[v].data;
+        next.push_back(s);
+      }
+    }
+    alive.swap(next);
   }
-  return p;
+  return P;
 }
 
 dict_t randomSample()
@@ -330,13 +416,10 @@ dict_t randomSample()
   for(int i=0; i<5; i++)
   {
     int diff = Rsize - R.size();
-    for(int j=0; j<diff; j++)
-    {
-      int u= distribution(rng);
-      path toAdd = randomPathTo(X[u]);
-      if(toAdd.size() < Q) continue;
-      R.insert(toAdd);
-    }
+    std::vector<int> from(diff);
+    for(int j=0; j<diff; j++) from[j] = X[distribution(rng)];
+    for(const path &toAdd : randomPaths(from))
+      if(toAdd.size() == Q) R.insert(toAdd);
   }
 
   for(const path& r : R) W.insert(L(r));
@@ -347,6 +430,7 @@ dict_t randomSample()
 fdict_t processFrequency(dict_t& W, int X)
 {
   fdict_t ret;
+  std::vector<dict_t> pre = prefixes(W);
 
   std::vector<std::tuple<int, path>> prec;
 
@@ -376,8 +460,7 @@ fdict_t processFrequency(dict_t& W, int X)
 
         p.push_back(v);
 
-        auto qp = L(p);
-        if (isPrefix(W, qp)) cur.emplace_back(v, p);
+        if (isPrefix(W, pre, L(p), qlen(p.size()))) cur.emplace_back(v, p);
 
         p.pop_back();
 
@@ -432,13 +515,10 @@ std::tuple<dict_t, fdict_t, fdict_t> randomSamplePlus()
   for(int i=0; i<5; i++)    // TODO Parametrize
   {
     int diff = Rsize-R.size();
-    for(int j=0; j<diff; j++)
-    {
-      int u = distribution(rng);
-      path toAdd = randomPathTo(X[u]);
-      if(toAdd.size() < Q) continue;
-      R.insert(toAdd);
-    }
+    std::vector<int> from(diff);
+    for(int j=0; j<diff; j++) from[j] = X[distribution(rng)];
+    for(const path &toAdd : randomPaths(from))
+      if(toAdd.size() == Q) R.insert(toAdd);
   }
 
   for(const path& p : R)
@@ -534,6 +614,37 @@ std::tuple<double, double> baseline()
   return std::make_tuple(fj, bc);
 }
 
+// Answer to a query line of --serve, "algorithm R A B" with algorithm one
+// of bruteforce, fcount, fsample, baseline -> "algorithm,FJ,BC,TIME". Query
+// number n draws from the generator seeded with seed + n, so its answer does
+// not depend on the others.
+std::string answerQuery(const std::string &line, uint64_t n)
+{
+  std::istringstream in(line);
+  std::string algorithm;
+  long long r, a, b;
+  if(!(in >> algorithm >> r >> a >> b) || r < 1) return "error,malformed query";
+  if(a < 0 || a >= N || b < 0 || b >= N) return "error,wrong node";
+  A = a;
+  B = b;
+  Rsize = r;
+  rng.seed(seed + n);
+
+  auto t = timer_start();
+  std::tuple<double, double> sim;
+  if(algorithm == "bruteforce") sim = bruteforce();
+  else if(algorithm == "fcount") sim = fcount();
+  else if(algorithm == "fsample") sim = fsample();
+  else if(algorithm == "baseline") sim = baseline();
+  else return "error,unknown algorithm " + algorithm;
+
+  std::ostringstream out;
+  out.setf(std::ios::fixed, std::ios::floatfield);
+  out.precision(6);
+  out << algorithm << "," << std::get<0>(sim) << "," << std::get<1>(sim) << "," << timer_step(t);
+  return out.str();
+}
+
 int main(int argc, char** argv) {
 
   // Parse arguments
@@ -545,12 +656,17 @@ int main(int argc, char** argv) {
     (    "v,verbose", "Verbose log",                                          cxxopts::value(verbose))
     (      "i,input", "Input file name (default: stdin)",                     cxxopts::value(input))
     (     "o,output", "Output file name (default: stdout)",                   cxxopts::value(output))
+    (      "save-dp", "Save the DP table to file",                            cxxopts::value(save_dp))
+    (      "load-dp", "Load the DP table from file instead of computing it",  cxxopts::value(load_dp))
     // Algorithms to run
     (   "bruteforce", "Compute similarity with bruteforce",                   cxxopts::value(bruteforce_f))
     (       "fcount", "Compute similarity with fCount",                       cxxopts::value(fcount_f))
     (      "fsample", "Compute similarity with fSample",                      cxxopts::value(fsample_f))
     (     "baseline", "Compute similarity with baseline",                     cxxopts::value(baseline_f))
     (          "all", "Compute similarity with all algorithms",               cxxopts::value(all))
+    // Query server
+    (        "serve", "Keep the graph and DP, answer queries from stdin",     cxxopts::value(serve))
+    (       "socket", "Serve the Unix socket file instead of stdin",          cxxopts::value(socket_path))
     // Experiments parameters
     ("e,experiments", "Number of experiments to run (default: 1)",            cxxopts::value(experiments))
     (      "r,rsize", "Size of the sample",                                   cxxopts::value(Rsize))
@@ -568,7 +684,7 @@ int main(int argc, char** argv) {
   auto result = options.parse(argc, argv);
 
   // Print help
-  if (help || !(bruteforce_f || fcount_f || fsample_f || baseline_f || all)) {
+  if (help || !(bruteforce_f || fcount_f || fsample_f || baseline_f || all || serve)) {
     std::cout << options.help();
     return 0;
   }
@@ -585,6 +701,7 @@ int main(int argc, char** argv) {
   ERROR(H < 1,"Number of hash functions too low");
   ERROR(Z < 1, "Number of bits in bloom filter too low");
   ERROR(H >= Z, "Too many hash functions (H >= Z)");
+  ERROR(serve && input.size() == 0 && socket_path.size() == 0, "Serving stdin needs the input file (-i)");
 
   // Set number of threads
   omp_set_num_threads(Nthreads);
@@ -602,19 +719,13 @@ int main(int argc, char** argv) {
 
   // Redirect cerr buffer
   if (!verbose) {
-    std::ofstream fnull("/dev/null");
+    static std::ofstream fnull("/dev/null");
     std::cerr.rdbuf(fnull.rdbuf());
   }
 
-  // Redirect cin buffer
-  if (input.size() != 0) {
-    std::ifstream fin(input);
-    std::cin.rdbuf(fin.rdbuf());
-  }
-
   // Redirect cout buffer
   if (output.size() != 0) {
-    std::ofstream fout(output);
+    static std::ofstream fout(output);
     std::cout.rdbuf(fout.rdbuf());
   }
 
@@ -626,7 +737,16 @@ int main(int argc, char** argv) {
   std::cerr.precision(6);
 
   // Read input
-  std::cin >> N >> M;
+  std::vector<int> in;
+  ERROR(!readTextInts(input.size() != 0 ? input.c_str() : NULL, in), "Reading input");
+  ERROR(in.size() < 2 || in.size() < 2 + (size_t)in[0], "Reading input");
+  N = in[0];
+  M = in[1];
+  if (in.size() < 2 + N + 2 * (size_t)M) {
+    std::cerr << "Input truncated, using the first " << (in.size() - 2 - N) / 2
+              << " edges" << std::endl;
+    M = (in.size() - 2 - N) / 2;
+  }
   std::cerr << "Read graph N = " << N << " M = " << M << std::endl;
 
   G = graph(N);
@@ -640,17 +760,15 @@ int main(int argc, char** argv) {
 
   // Reading labels
   std::cerr << "Reading labels..." << std::endl;
-  for (int i = 0; i < N; i++) std::cin >> G.label[i];
+  for (int i = 0; i < N; i++) G.label[i] = '0' + in[2 + i]; // one digit labels
   for (int i = 0; i < N; i++) G.label[i] += 33; // make printable, maybe change?
+  labelBits = qgramBits(G.label.data(), N, labelBase);
+  ERROR(qlen(Q) * labelBits > 8 * sizeof(qpath), "Labels of the paths too long");
   std::cerr << "end" << std::endl;
 
   // Reading nodes
   std::cerr << "Reading edges..." << std::endl;
-  for (int i = 0; i < M; i++) {
-    int a, b;
-    std::cin >> a >> b;
-    G.addEdge(a, b);
-  }
+  G.build(in.data() + 2 + N, M);
   std::cerr << "end" << std::endl;
 
   // Create filter
@@ -682,14 +800,33 @@ int main(int argc, char** argv) {
     std::cerr << "Real BC(A,B) = " << real_bc << std::endl;
   }
 
-  // Process DP only if fcount or fsample are enabled
-  if(fcount_f || fsample_f)
+  // Process DP only if fcount or fsample are enabled (or serving)
+  if(fcount_f || fsample_f || serve)
   {
     std::cerr << "Start processing DP Table..." << std::endl;
-    processDP();
+    if(load_dp.size() != 0)
+    {
+      ERROR(!loadDP(load_dp), "Loading DP table");
+    }
+    else processDP();
+    if(save_dp.size() != 0)
+    {
+      ERROR(!saveDP(save_dp), "Saving DP table");
+    }
     std::cerr << "end" << std::endl;
   }
 
+  // Serve the queries with the graph and the DP table in memory
+  if(serve)
+  {
+    std::cerr << "Serving queries: algorithm R A B" << std::endl;
+    uint64_t queries = 0;
+    ERROR(!serveQueries(socket_path.size() != 0 ? socket_path.c_str() : NULL,
+                        [&](const std::string &line) { return answerQuery(line, queries++); }),
+          "Serving queries");
+    return 0;
+  }
+
   // Print CSV headers
   if(bruteforce_f)
   {
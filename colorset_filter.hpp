@@ -0,0 +1,111 @@
+#ifndef _COLORSET_FILTER_HPP
+#define _COLORSET_FILTER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// Filter-and-insert kernel of the color-coding DP: copy to out the colorsets
+// of in[0..n) not containing bit, with bit set, and their counts to outCnt.
+// Returns the number of survivors. out and outCnt must have room for n + 16
+// elements, the kernels write whole blocks past the last survivor.
+// The AVX2 / AVX-512 versions (uint32_t colorsets) are used when compiling
+// with -mavx2 / -mavx512f (or -march=native).
+template <typename C>
+inline size_t filterColorsets(const C *in, const long long *cnt, size_t n,
+                              C bit, C *out, long long *outCnt) {
+  size_t k = 0;
+  for (size_t i = 0; i < n; i++) {
+    out[k] = in[i] | bit;
+    outCnt[k] = cnt[i];
+    k += (in[i] & bit) == 0;
+  }
+  return k;
+}
+
+#if defined(__AVX512F__)
+
+inline size_t filterColorsets(const uint32_t *in, const long long *cnt,
+                              size_t n, uint32_t bit, uint32_t *out,
+                              long long *outCnt) {
+  const __m512i vbit = _mm512_set1_epi32(bit);
+  size_t i = 0, k = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i s = _mm512_loadu_si512((const void *)(in + i));
+    __mmask16 keep = _mm512_testn_epi32_mask(s, vbit);
+    __m512i c0 = _mm512_loadu_si512((const void *)(cnt + i));
+    __m512i c1 = _mm512_loadu_si512((const void *)(cnt + i + 8));
+    _mm512_mask_compressstoreu_epi32(out + k, keep, _mm512_or_si512(s, vbit));
+    _mm512_mask_compressstoreu_epi64(outCnt + k, (__mmask8)keep, c0);
+    size_t k0 = __builtin_popcount(keep & 0xff);
+    _mm512_mask_compressstoreu_epi64(outCnt + k + k0, (__mmask8)(keep >> 8), c1);
+    k += __builtin_popcount(keep);
+  }
+  return k + filterColorsets<uint32_t>(in + i, cnt + i, n - i, bit, out + k,
+                                       outCnt + k);
+}
+
+#elif defined(__AVX2__)
+
+// Permutations moving the selected lanes of a 8 x 32-bit register first:
+// row m for a mask of 8 lanes, row 256 + m for a mask of 4 x 64-bit lanes
+struct CompressLUT {
+  int32_t lut[256 + 16][8];
+
+  CompressLUT() {
+    for (int m = 0; m < 256; m++) {
+      int k = 0;
+      for (int j = 0; j < 8; j++)
+        if ((m >> j) & 1) lut[m][k++] = j;
+      for (; k < 8; k++) lut[m][k] = 0;
+    }
+    for (int m = 0; m < 16; m++) {
+      int k = 0;
+      for (int j = 0; j < 4; j++)
+        if ((m >> j) & 1) {
+          lut[256 + m][k++] = 2 * j;
+          lut[256 + m][k++] = 2 * j + 1;
+        }
+      for (; k < 8; k++) lut[256 + m][k] = 0;
+    }
+  }
+};
+
+inline const int32_t *compressLUT() {
+  static CompressLUT table;
+  return &table.lut[0][0];
+}
+
+inline size_t filterColorsets(const uint32_t *in, const long long *cnt,
+                              size_t n, uint32_t bit, uint32_t *out,
+                              long long *outCnt) {
+  const int32_t *lut = compressLUT();
+  const __m256i vbit = _mm256_set1_epi32(bit);
+  size_t i = 0, k = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i s = _mm256_loadu_si256((const __m256i *)(in + i));
+    __m256i has = _mm256_cmpeq_epi32(_mm256_and_si256(s, vbit), vbit);
+    int keep = ~_mm256_movemask_ps(_mm256_castsi256_ps(has)) & 0xff;
+    __m256i perm = _mm256_loadu_si256((const __m256i *)(lut + 8 * keep));
+    _mm256_storeu_si256((__m256i *)(out + k),
+                        _mm256_permutevar8x32_epi32(_mm256_or_si256(s, vbit), perm));
+
+    int m0 = keep & 0xf, m1 = keep >> 4;
+    __m256i c0 = _mm256_loadu_si256((const __m256i *)(cnt + i));
+    __m256i c1 = _mm256_loadu_si256((const __m256i *)(cnt + i + 4));
+    __m256i p0 = _mm256_loadu_si256((const __m256i *)(lut + 8 * (256 + m0)));
+    __m256i p1 = _mm256_loadu_si256((const __m256i *)(lut + 8 * (256 + m1)));
+    _mm256_storeu_si256((__m256i *)(outCnt + k), _mm256_permutevar8x32_epi32(c0, p0));
+    size_t k0 = __builtin_popcount(m0);
+    _mm256_storeu_si256((__m256i *)(outCnt + k + k0), _mm256_permutevar8x32_epi32(c1, p1));
+    k += __builtin_popcount(keep);
+  }
+  return k + filterColorsets<uint32_t>(in + i, cnt + i, n - i, bit, out + k,
+                                       outCnt + k);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,351 @@
+#ifndef _DP_LAYER_HPP
+#define _DP_LAYER_HPP
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+#include <omp.h>
+#include "colorset_filter.hpp"
+#include "dp_schedule.hpp"
+#include "numa_place.hpp"
+
+// One level of the color-coding DP table in sparse form: for every node the
+// colorsets of its paths, sorted, and the number of paths for each of them.
+// The arrays are either owned (offData, csData, cntData) or point into a
+// mapped DP file (see dp_store.hpp) or into placed memory, owned by placed
+// (see numa_place.hpp). As for CSRGraph, a compact layer has
+// its rows in node order without gaps, end = off + 1; replaceRows makes it
+// loose, with the row ends in endData and the changed rows out of place.
+template <typename C>
+struct DPLayer {
+  uint64_t *off;   // entries of node u are in [off[u], end[u])
+  uint64_t *end;
+  C *cs;           // colorsets
+  long long *cnt;  // number of paths with that colorset
+  size_t m;        // number of entries
+  std::vector<uint64_t> offData;
+  std::vector<uint64_t> endData, roomData;  // only if loose
+  std::vector<C> csData;
+  std::vector<long long> cntData;
+  NumaMemory placed;
+
+  DPLayer() : off(NULL), end(NULL), cs(NULL), cnt(NULL), m(0) {}
+  DPLayer(const DPLayer &o) { *this = o; }
+
+  DPLayer &operator=(const DPLayer &o) {
+    offData = o.offData;
+    endData = o.endData;
+    roomData = o.roomData;
+    csData = o.csData;
+    cntData = o.cntData;
+    placed = o.placed;
+    if (o.off == o.offData.data()) {
+      own();
+      m = o.m;
+    } else {
+      off = o.off;
+      end = o.end;
+      cs = o.cs;
+      cnt = o.cnt;
+      m = o.m;
+    }
+    return *this;
+  }
+
+  // Point the layer to the owned arrays (compact unless endData is set)
+  void own() {
+    off = offData.data();
+    end = compact() ? off + 1 : endData.data();
+    cs = csData.data();
+    cnt = cntData.data();
+    m = csData.size();
+  }
+
+  size_t size(int u) const { return end[u] - off[u]; }
+  size_t entries() const { return m; }
+  bool compact() const { return endData.empty(); }
+
+  // Number of paths ending in u with colorset s (0 if missing)
+  long long get(int u, C s) const {
+    const C *b = cs + off[u];
+    const C *e = cs + end[u];
+    const C *it = std::lower_bound(b, e, s);
+    if (it == e || *it != s) return 0ll;
+    return cnt[it - cs];
+  }
+
+  void clear() {
+    std::vector<uint64_t>().swap(offData);
+    std::vector<uint64_t>().swap(endData);
+    std::vector<uint64_t>().swap(roomData);
+    std::vector<C>().swap(csData);
+    std::vector<long long>().swap(cntData);
+    NumaMemory().swap(placed);
+    own();
+  }
+};
+
+// Rows back in node order without gaps
+template <typename C>
+void packLayer(DPLayer<C> &L, unsigned int n) {
+  if (L.compact()) return;
+  std::vector<uint64_t> off(n + 1);
+  off[0] = 0;
+  for (unsigned int u = 0; u < n; u++) off[u + 1] = off[u] + L.size(u);
+  std::vector<C> oCs(off[n]);
+  std::vector<long long> oCnt(off[n]);
+  #pragma omp parallel for schedule(guided)
+  for (unsigned int u = 0; u < n; u++) {
+    std::copy(L.cs + L.off[u], L.cs + L.end[u], oCs.begin() + off[u]);
+    std::copy(L.cnt + L.off[u], L.cnt + L.end[u], oCnt.begin() + off[u]);
+  }
+  L.offData.swap(off);
+  std::vector<uint64_t>().swap(L.endData);
+  std::vector<uint64_t>().swap(L.roomData);
+  L.csData.swap(oCs);
+  L.cntData.swap(oCnt);
+  NumaMemory().swap(L.placed);
+  L.own();
+}
+
+// Replace the rows of nodes with cs[j] / cnt[j], in place or moved to the
+// end of the arrays (see rowSlot): the cost is that of the new rows, the
+// layer is loose and owns its arrays after, and is packed again when the
+// gaps outgrow the entries.
+template <typename C>
+void replaceRows(DPLayer<C> &L, unsigned int n, const std::vector<int> &nodes,
+                 const std::vector<std::vector<C>> &cs,
+                 const std::vector<std::vector<long long>> &cnt) {
+  if (n == 0) return;
+  if (L.compact()) {
+    if (L.off != L.offData.data()) {
+      L.offData.assign(L.off, L.off + n + 1);
+      L.csData.assign(L.cs, L.cs + L.off[n]);
+      L.cntData.assign(L.cnt, L.cnt + L.off[n]);
+      NumaMemory().swap(L.placed);
+    }
+    L.endData.assign(L.offData.begin() + 1, L.offData.end());
+    L.roomData = L.endData;
+  }
+  size_t m = L.m;
+  L.own();
+
+  size_t size = L.csData.size();
+  for (size_t j = 0; j < nodes.size(); j++) {
+    m += cs[j].size();
+    m -= L.size(nodes[j]);
+    uint64_t b = rowSlot(L.off, L.end, L.roomData.data(), nodes[j], cs[j].size(), size);
+    L.csData.resize(size);
+    L.cntData.resize(size);
+    std::copy(cs[j].begin(), cs[j].end(), L.csData.begin() + b);
+    std::copy(cnt[j].begin(), cnt[j].end(), L.cntData.begin() + b);
+  }
+  L.own();
+  L.m = m;
+  if (L.csData.size() > 2 * m + n) packLayer(L, n);
+}
+
+// Level 1: every node u has the single colorset {color[u]}
+template <typename C>
+void initLayer(DPLayer<C> &L, unsigned int n, const int *color) {
+  L.offData.resize(n + 1);
+  L.csData.resize(n);
+  L.cntData.assign(n, 1ll);
+  for (unsigned int u = 0; u <= n; u++) L.offData[u] = u;
+  for (unsigned int u = 0; u < n; u++) L.csData[u] = (C)1 << color[u];
+  L.own();
+}
+
+// k-way merge of the sorted runs [pos[j], end[j]) of cs / cnt into oCs /
+// oCnt, summing the counts of equal colorsets
+template <typename C>
+void mergeRuns(const C *cs, const long long *cnt, std::vector<size_t> &pos,
+               const std::vector<size_t> &end,
+               std::vector<std::pair<C, int>> &heap, std::vector<C> &oCs,
+               std::vector<long long> &oCnt) {
+  heap.clear();
+  for (size_t j = 0; j < pos.size(); j++)
+    if (pos[j] < end[j]) heap.push_back(std::make_pair(cs[pos[j]], (int)j));
+  std::make_heap(heap.begin(), heap.end(), std::greater<std::pair<C, int>>());
+
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<C, int>>());
+    int j = heap.back().second;
+    heap.pop_back();
+
+    C s = cs[pos[j]];
+    long long f = cnt[pos[j]];
+    if (!oCs.empty() && oCs.back() == s)
+      oCnt.back() += f;
+    else {
+      oCs.push_back(s);
+      oCnt.push_back(f);
+    }
+
+    if (++pos[j] == end[j]) continue;
+    heap.push_back(std::make_pair(cs[pos[j]], j));
+    std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<C, int>>());
+  }
+}
+
+// Level i from level i-1, for several colorings at once: L[c] from P[c] with
+// the coloring color[c * n .. (c + 1) * n). Every neighbour scan serves all
+// the colorings. The row of u is the k-way merge of the rows of its
+// neighbours, without the colorsets containing color[u] and with its bit set.
+// Every neighbour row goes through filterColorsets() first; setting the same
+// missing bit keeps the filtered rows sorted.
+// The work is split by makeSchedule() on the size of the neighbour rows: the
+// neighbours of a hub are merged in chunks by different threads, and the
+// partial rows merged again at the end.
+template <typename C>
+void buildLayers(DPLayer<C> *L, const DPLayer<C> *P, unsigned int colorings,
+                 unsigned int n, const CSRGraph &G, const int *color) {
+  std::vector<std::vector<C>> rowCs((size_t)colorings * n);
+  std::vector<std::vector<long long>> rowCnt((size_t)colorings * n);
+
+  DPSchedule S = makeSchedule(G, n, [&](int v) {
+    uint64_t w = 0;
+    for (unsigned int c = 0; c < colorings; c++) w += P[c].size(v);
+    return w;
+  });
+  size_t parts = S.parts();
+  std::vector<std::vector<C>> partCs((size_t)colorings * parts);
+  std::vector<std::vector<long long>> partCnt((size_t)colorings * parts);
+
+  #pragma omp parallel
+  {
+    std::vector<std::pair<C, int>> heap;
+    std::vector<size_t> pos, end;
+    std::vector<C> fCs;
+    std::vector<long long> fCnt;
+
+    // Merge the filtered rows of the neighbours vb..ve of u into o
+    auto mergeRow = [&](unsigned int c, unsigned int u, const int *vb,
+                        const int *ve, std::vector<C> &oCs,
+                        std::vector<long long> &oCnt) {
+      const DPLayer<C> &Pc = P[c];
+      C bit = (C)1 << color[(size_t)c * n + u];
+      size_t tot = 16;
+      for (const int *v = vb; v != ve; v++) tot += Pc.size(*v);
+      if (fCs.size() < tot) {
+        fCs.resize(tot);
+        fCnt.resize(tot);
+      }
+
+      pos.clear();
+      end.clear();
+      size_t k = 0;
+      for (const int *v = vb; v != ve; v++) {
+        size_t b = Pc.off[*v];
+        size_t f = filterColorsets(Pc.cs + b, Pc.cnt + b, Pc.size(*v), bit,
+                                   &fCs[k], &fCnt[k]);
+        if (f == 0) continue;
+        pos.push_back(k);
+        end.push_back(k + f);
+        k += f;
+      }
+      mergeRuns(fCs.data(), fCnt.data(), pos, end, heap, oCs, oCnt);
+    };
+
+    #pragma omp for schedule(runtime)
+    for (size_t t = 0; t < S.tasks.size(); t++) {
+      const DPTask &T = S.tasks[t];
+      for (unsigned int c = 0; c < colorings; c++) {
+        if (T.part >= 0) {
+          size_t r = (size_t)c * parts + T.part;
+          mergeRow(c, T.u, G.adj + T.b, G.adj + T.e, partCs[r], partCnt[r]);
+          continue;
+        }
+        for (unsigned int u = T.u; u < T.uEnd; u++) {
+          size_t r = (size_t)c * n + u;
+          mergeRow(c, u, G[u].begin(), G[u].end(), rowCs[r], rowCnt[r]);
+        }
+      }
+    }
+
+    // Merge the partial rows of the hubs
+    #pragma omp for schedule(dynamic, 1)
+    for (size_t h = 0; h < S.hubs.size(); h++) {
+      for (unsigned int c = 0; c < colorings; c++) {
+        size_t r0 = (size_t)c * parts;
+        size_t tot = 0;
+        for (size_t p = S.hubParts[h]; p < S.hubParts[h + 1]; p++)
+          tot += partCs[r0 + p].size();
+        if (fCs.size() < tot) {
+          fCs.resize(tot);
+          fCnt.resize(tot);
+        }
+
+        pos.clear();
+        end.clear();
+        size_t k = 0;
+        for (size_t p = S.hubParts[h]; p < S.hubParts[h + 1]; p++) {
+          std::copy(partCs[r0 + p].begin(), partCs[r0 + p].end(), fCs.begin() + k);
+          std::copy(partCnt[r0 + p].begin(), partCnt[r0 + p].end(), fCnt.begin() + k);
+          pos.push_back(k);
+          k += partCs[r0 + p].size();
+          end.push_back(k);
+          std::vector<C>().swap(partCs[r0 + p]);
+          std::vector<long long>().swap(partCnt[r0 + p]);
+        }
+        size_t r = (size_t)c * n + S.hubs[h];
+        mergeRuns(fCs.data(), fCnt.data(), pos, end, heap, rowCs[r], rowCnt[r]);
+      }
+    }
+  }
+
+  // Compact the rows into the contiguous arrays: owned, or under NUMA
+  // placement first touched by the threads processing the rows (see
+  // numa_place.hpp)
+  bool placed = dpPlacement();
+  for (unsigned int c = 0; c < colorings; c++) {
+    size_t r = (size_t)c * n;
+    std::vector<uint64_t>().swap(L[c].endData);
+    std::vector<uint64_t>().swap(L[c].roomData);
+    NumaMemory().swap(L[c].placed);
+    std::vector<uint64_t> &off = L[c].offData;
+    off.resize(n + 1);
+    off[0] = 0;
+    for (unsigned int u = 0; u < n; u++) off[u + 1] = off[u] + rowCs[r + u].size();
+    if (placed) {
+      L[c].csData.clear();
+      L[c].cntData.clear();
+      L[c].off = numaAlloc<uint64_t>(n + 1, L[c].placed);
+      L[c].end = L[c].off + 1;
+      L[c].cs = numaAlloc<C>(off[n], L[c].placed);
+      L[c].cnt = numaAlloc<long long>(off[n], L[c].placed);
+      L[c].m = off[n];
+      L[c].off[n] = off[n];
+    } else {
+      L[c].csData.resize(off[n]);
+      L[c].cntData.resize(off[n]);
+      L[c].own();
+    }
+
+    #pragma omp parallel for schedule(runtime)
+    for (size_t t = 0; t < S.tasks.size(); t++) {
+      const DPTask &T = S.tasks[t];
+      if (T.part >= 0 && T.b != G.off[T.u]) continue;
+      for (unsigned int u = T.u; u < T.uEnd; u++) {
+        L[c].off[u] = off[u];
+        std::copy(rowCs[r + u].begin(), rowCs[r + u].end(), L[c].cs + off[u]);
+        std::copy(rowCnt[r + u].begin(), rowCnt[r + u].end(), L[c].cnt + off[u]);
+        std::vector<C>().swap(rowCs[r + u]);
+        std::vector<long long>().swap(rowCnt[r + u]);
+      }
+    }
+    if (placed) std::vector<uint64_t>().swap(off);
+  }
+}
+
+// Level i from level i-1 for a single coloring
+template <typename C>
+void buildLayer(DPLayer<C> &L, const DPLayer<C> &P, unsigned int n,
+                const CSRGraph &G, const int *color) {
+  buildLayers(&L, &P, 1, n, G, color);
+}
+
+#endif
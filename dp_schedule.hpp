@@ -0,0 +1,108 @@
+#ifndef _DP_SCHEDULE_HPP
+#define _DP_SCHEDULE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include "graph_read.hpp"
+
+// Edge-centric split of the work of a DP level in tasks of about the same
+// weight. Consecutive light nodes are grouped in one task; the neighbour
+// range of a heavy node (hub) is split in several tasks, each one writing a
+// partial row that is merged into the row of the hub once all are done.
+// The tasks run with schedule(runtime), set by makeSchedule(): dynamic, or
+// static under NUMA placement (see numa_place.hpp).
+struct DPTask {
+  unsigned int u, uEnd;  // nodes [u, uEnd), or the hub u if part >= 0
+  uint64_t b, e;         // neighbours adj[b..e) of the hub
+  int part;              // partial row of the hub chunk, -1 for a node block
+};
+
+struct DPSchedule {
+  std::vector<DPTask> tasks;
+  std::vector<unsigned int> hubs;  // hubs split in several tasks
+  std::vector<size_t> hubParts;    // partial rows of hubs[h] are
+                                   // [hubParts[h], hubParts[h + 1])
+
+  size_t parts() const { return hubParts.empty() ? 0 : hubParts.back(); }
+};
+
+// NUMA placement: every thread runs the same contiguous range of tasks at
+// every level, the range whose graph slice and rows it first touched. The
+// partition must not change between levels, so every arc weighs 1.
+inline bool &dpPlacement() {
+  static bool placed = false;
+  return placed;
+}
+
+// Schedule of the nodes [0, n) of G; weight(v) is the work of reading the
+// row of the neighbour v. The grain (weight of a task) defaults to 1/16 of
+// the work of a thread.
+template <typename Weight>
+DPSchedule makeSchedule(const CSRGraph &G, unsigned int n, Weight weight,
+                        uint64_t grain = 0) {
+  bool placed = dpPlacement();
+  std::vector<uint64_t> w(n);
+  uint64_t total = 0;
+  #pragma omp parallel for schedule(guided) reduction(+ : total)
+  for (unsigned int u = 0; u < n; u++) {
+    uint64_t s = 1;
+    for (int v : G[u]) s += placed ? 1 : weight(v);
+    w[u] = s;
+    total += s;
+  }
+  if (grain == 0) grain = std::max((uint64_t)1024, total / (16 * (uint64_t)csrThreads()));
+
+  DPSchedule S;
+  S.hubParts.push_back(0);
+  int part = 0;
+  unsigned int first = 0;
+  uint64_t acc = 0;
+  for (unsigned int u = 0; u < n; u++) {
+    if (w[u] <= grain) {
+      acc += w[u];
+      if (acc >= grain) {
+        DPTask t = {first, u + 1, 0, 0, -1};
+        S.tasks.push_back(t);
+        first = u + 1;
+        acc = 0;
+      }
+      continue;
+    }
+
+    // Hub: close the current block, then split the neighbours of u
+    if (first < u) {
+      DPTask t = {first, u, 0, 0, -1};
+      S.tasks.push_back(t);
+    }
+    uint64_t b = G.off[u], chunk = 0;
+    for (uint64_t j = G.off[u]; j < G.end[u]; j++) {
+      chunk += placed ? 1 : weight(G.adj[j]);
+      if (chunk >= grain || j + 1 == G.end[u]) {
+        DPTask t = {u, u + 1, b, j + 1, part++};
+        S.tasks.push_back(t);
+        b = j + 1;
+        chunk = 0;
+      }
+    }
+    S.hubs.push_back(u);
+    S.hubParts.push_back(part);
+    first = u + 1;
+    acc = 0;
+  }
+  if (first < n) {
+    DPTask t = {first, n, 0, 0, -1};
+    S.tasks.push_back(t);
+  }
+
+#ifdef _OPENMP
+  if (placed)
+    omp_set_schedule(omp_sched_static, 0);
+  else
+    omp_set_schedule(omp_sched_dynamic, 1);
+#endif
+  return S;
+}
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef _DP_STORE_HPP
+#define _DP_STORE_HPP
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "graph_read.hpp"
+#include "dp_layer.hpp"
+
+// Color-coding DP table file (.dp), version 1, native endianness. The table
+// depends only on the graph, q and the coloring, which form its key:
+//   DPHeader
+//   coloring                                     (n * colorBytes bytes, padded)
+//   for every level i = 1..q (and every coloring, if colorBytes holds more)
+//     dense:  int64_t table[n * C(q, i)]
+//     sparse: uint64_t entries, uint64_t off[n + 1],
+//             colorsets[entries] (keyBytes each, padded), int64_t cnt[entries]
+// Every array starts at a multiple of 8 bytes, so the file can be mapped and
+// its arrays used in place.
+#define DP_MAGIC "CCDP"
+#define DP_VERSION 1
+#define DP_DENSE 1
+
+struct DPHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t q, n;
+  uint32_t keyBytes;    // bytes of a colorset
+  uint32_t colorBytes;  // bytes of the color of a node
+  uint32_t flags;
+  uint32_t reserved;
+  uint64_t graphHash, colorHash;
+};
+
+// 64-bit hash of a byte array, 8 bytes at a time
+inline uint64_t hashBytes(const void *data, size_t bytes,
+                          uint64_t h = 0x9e3779b97f4a7c15ull) {
+  const unsigned char *p = (const unsigned char *)data;
+  size_t i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    uint64_t w;
+    memcpy(&w, p + i, 8);
+    h = (h ^ w) * 0xff51afd7ed558ccdull;
+    h ^= h >> 32;
+  }
+  for (; i < bytes; i++) h = (h ^ p[i]) * 0x100000001b3ull;
+  return h ^ bytes;
+}
+
+// Hash of G, compact (see CSRGraph::pack)
+inline uint64_t hashGraph(const CSRGraph &G) {
+  uint64_t h = hashBytes(&G.n, sizeof(G.n));
+  h = hashBytes(G.off, (G.n + 1) * sizeof(uint64_t), h);
+  return hashBytes(G.adj, G.m * sizeof(int), h);
+}
+
+inline DPHeader makeDPHeader(unsigned int q, const CSRGraph &G,
+                             const void *color, size_t colorBytes,
+                             size_t keyBytes, bool dense) {
+  DPHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, DP_MAGIC, 4);
+  h.version = DP_VERSION;
+  h.q = q;
+  h.n = G.n;
+  h.keyBytes = keyBytes;
+  h.colorBytes = colorBytes;
+  h.flags = dense ? DP_DENSE : 0;
+  h.graphHash = hashGraph(G);
+  h.colorHash = hashBytes(color, G.n * colorBytes);
+  return h;
+}
+
+// Sequential writer of a DP file
+struct DPFileWriter {
+  FILE *f;
+  bool ok;
+
+  DPFileWriter(const char *filename, const DPHeader &h, const void *color) {
+    f = fopen(filename, "wb");
+    ok = f != NULL;
+    if (!ok) {
+      perror("Error opening DP file");
+      return;
+    }
+    write(&h, sizeof(h));
+    write(color, (size_t)h.n * h.colorBytes);
+  }
+
+  // Write bytes, padded to a multiple of 8
+  void write(const void *data, size_t bytes) {
+    const char pad[8] = {0};
+    size_t padding = (8 - bytes % 8) % 8;
+    if (!ok) return;
+    ok = fwrite(data, 1, bytes, f) == bytes && fwrite(pad, 1, padding, f) == padding;
+  }
+
+  bool close() {
+    if (f == NULL) return false;
+    if (fclose(f) != 0) ok = false;
+    f = NULL;
+    if (!ok) perror("Error writing DP file");
+    return ok;
+  }
+};
+
+// DP file mapped in memory (privately, until the process exits)
+struct DPFile {
+  DPHeader h;
+  const void *color;
+  char *p, *end;
+
+  // Map filename and check that it is a DP file; the key is checked by the
+  // caller (see matches)
+  bool open(const char *filename) {
+    int fd = ::open(filename, O_RDONLY);
+    if (fd == -1) {
+      perror("Error opening DP file");
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(DPHeader)) {
+      fprintf(stderr, "Invalid DP file %s\n", filename);
+      ::close(fd);
+      return false;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      perror("Error mapping DP file");
+      return false;
+    }
+    memcpy(&h, base, sizeof(h));
+    p = (char *)base + sizeof(h);
+    end = (char *)base + st.st_size;
+    if (memcmp(h.magic, DP_MAGIC, 4) != 0 || h.version != DP_VERSION) {
+      fprintf(stderr, "Invalid DP file %s\n", filename);
+      munmap(base, st.st_size);
+      return false;
+    }
+    color = next<char>((size_t)h.n * h.colorBytes);
+    return color != NULL;
+  }
+
+  // True if the table was built for q on G with the given coloring
+  bool matches(unsigned int q, const CSRGraph &G, const void *color,
+               size_t colorBytes, size_t keyBytes) const {
+    DPHeader k = makeDPHeader(q, G, color, colorBytes, keyBytes, false);
+    return h.q == k.q && h.n == k.n && h.keyBytes == k.keyBytes &&
+           h.colorBytes == k.colorBytes && h.graphHash == k.graphHash &&
+           h.colorHash == k.colorHash;
+  }
+
+  // Next array of count T's, NULL if the file is too short
+  template <typename T>
+  T *next(size_t count) {
+    size_t bytes = count * sizeof(T);
+    size_t padded = (bytes + 7) & ~(size_t)7;
+    if ((size_t)(end - p) < padded) {
+      fprintf(stderr, "DP file truncated\n");
+      return NULL;
+    }
+    T *r = (T *)p;
+    p += padded;
+    return r;
+  }
+};
+
+// Sparse level stored as in DPLayer (compact, see packLayer)
+template <typename C>
+void writeLayer(DPFileWriter &w, const DPLayer<C> &L, unsigned int n) {
+  uint64_t e = L.entries();
+  w.write(&e, sizeof(e));
+  w.write(L.off, (n + 1) * sizeof(uint64_t));
+  w.write(L.cs, e * sizeof(C));
+  w.write(L.cnt, e * sizeof(long long));
+}
+
+// Point L into the next level of f
+template <typename C>
+bool mapLayer(DPFile &f, DPLayer<C> &L, unsigned int n) {
+  uint64_t *e = f.next<uint64_t>(1);
+  if (e == NULL) return false;
+  L.clear();
+  L.off = f.next<uint64_t>(n + 1);
+  L.cs = f.next<C>(*e);
+  L.cnt = f.next<long long>(*e);
+  L.m = *e;
+  if (L.off == NULL || L.cs == NULL || L.cnt == NULL) return false;
+  L.end = L.off + 1;
+  return true;
+}
+
+// Level stored as one std::map (colorset -> count) per node, written in the
+// same form as a DPLayer
+template <typename Map>
+void writeMapLayer(DPFileWriter &w, const Map *rows, unsigned int n) {
+  typedef typename Map::key_type K;
+  std::vector<uint64_t> off(n + 1, 0);
+  for (unsigned int u = 0; u < n; u++) off[u + 1] = off[u] + rows[u].size();
+  std::vector<K> cs;
+  std::vector<long long> cnt;
+  cs.reserve(off[n]);
+  cnt.reserve(off[n]);
+  for (unsigned int u = 0; u < n; u++)
+    for (auto &e : rows[u]) {
+      cs.push_back(e.first);
+      cnt.push_back(e.second);
+    }
+  uint64_t e = off[n];
+  w.write(&e, sizeof(e));
+  w.write(off.data(), off.size() * sizeof(uint64_t));
+  w.write(cs.data(), cs.size() * sizeof(K));
+  w.write(cnt.data(), cnt.size() * sizeof(long long));
+}
+
+template <typename Map>
+bool readMapLayer(DPFile &f, Map *rows, unsigned int n) {
+  typedef typename Map::key_type K;
+  uint64_t *e = f.next<uint64_t>(1);
+  if (e == NULL) return false;
+  uint64_t *off = f.next<uint64_t>(n + 1);
+  K *cs = f.next<K>(*e);
+  long long *cnt = f.next<long long>(*e);
+  if (off == NULL || cs == NULL || cnt == NULL) return false;
+
+  #pragma omp parallel for schedule(guided)
+  for (unsigned int u = 0; u < n; u++) {
+    rows[u].clear();
+    for (uint64_t j = off[u]; j < off[u + 1]; j++)
+      rows[u].emplace_hint(rows[u].end(), cs[j], cnt[j]);
+  }
+  return true;
+}
+
+#endif
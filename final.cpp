@@ -13,6 +13,7 @@ using the color-coding technique (parallel version)
 #include <random>
 #include <queue>
 #include <limits>
+#include <sstream>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <string.h>
@@ -22,6 +23,21 @@ using the color-coding technique (parallel version)
 #include <unistd.h>
 #include <time.h>
 #include <sys/time.h>
+#include "graph_read.hpp"
+#include "dp_layer.hpp"
+#include "dp_schedule.hpp"
+#include "dp_store.hpp"
+#include "graph_order.hpp"
+#include "numa_place.hpp"
+#include "path_sampler.hpp"
+#include "philox.hpp"
+#include "path_set.hpp"
+#include "stream_similarity.hpp"
+#include "path_sketch.hpp"
+#include "query_server.hpp"
+#include "qgram.hpp"
+#include "label_trie.hpp"
+#include "frontier.hpp"
 
 #ifdef Q_8
 #define MAXQ 8
@@ -105,12 +121,16 @@ typedef long long ll;
 
 unsigned int N, E;
 static int verbose_flag, help_flag, bruteforce_flag, fcount_flag, fsample_flag, baseline_flag;
+static int numa_flag, index_flag, serve_flag;
 
 ll cont = 0;
-int *color;
-char *label;
-vector<int> *G;
+int *color;  // colorings * N colors, coloring c in [c * N, (c + 1) * N)
+unsigned char *label;  // node labels, the symbols of the packed path labels
+unsigned int labelBits = 1;  // bits per symbol in a QGram
+CSRGraph G;
 int *A, *B;
+vector<int> newId;  // new id of every node of the input graph, if reordered
+vector<int> threadNode, nodeOf;  // NUMA node of every thread and graph node
 
 // parameter
 unsigned int q = 0;
@@ -120,12 +140,13 @@ unsigned int R = 10;
 unsigned int Sa = 10, Sb = 10;
 unsigned int mod = 0;
 unsigned int experiment = 10;
-
-inline int nextInt() {
-  int r;
-  scanf("%d", &r);
-  return r;
-}
+unsigned int colorings = 1;
+double epsilon = 0;  // fsample stops at +-epsilon (0: fixed R samples)
+double delta = 0.05;
+unsigned int bootstraps = 32;
+unsigned int sketch_size = 64;  // --index: hashes per node, in bands
+unsigned int bands = 16;
+unsigned int top = 10;
 
 // Random generator
 mt19937_64 eng;
@@ -143,198 +164,665 @@ COLORSET clearBit(COLORSET n, int pos) { return n &= ~(1 << pos); }
 // Complementary set of a COLORSET
 COLORSET getCompl(COLORSET n) { return ((1 << q) - 1) & (~n); }
 
-// Random coloring graph using q color
+// Random coloring graph using q color, colorings times
 inline void randomColor() {
-  for (unsigned int i = 0; i < N; i++) color[i] = eng() % q;
+  for (size_t i = 0; i < (size_t)colorings * N; i++) color[i] = eng() % q;
+
+  // The colors are drawn in the order of the input graph
+  if (newId.empty()) return;
+  vector<int> in(color, color + (size_t)colorings * N);
+  for (unsigned int c = 0; c < colorings; c++)
+    for (unsigned int u = 0; u < N; u++)
+      color[(size_t)c * N + newId[u]] = in[(size_t)c * N + u];
+}
+
+// Colors of the c-th coloring
+inline int *colorsOf(unsigned int c) { return color + (size_t)c * N; }
+
+// Node labels from the input (all 0 if in is NULL) and the bits per symbol
+// of the packed path labels; false if a label is not in 0..255 or a q-path
+// label does not fit in a QGram
+bool readLabels(const int *in) {
+  label = new unsigned char[N + 1];
+  unsigned int sigma = 1;
+  for (unsigned int i = 0; i < N; i++) {
+    int l = in != NULL ? in[i] : 0;
+    if (l < 0 || l > 255) {
+      printf("Wrong label %d of node %u (only 0..255)\n", l, i);
+      return false;
+    }
+    label[i] = l;
+    sigma = max(sigma, (unsigned int)l + 1);
+  }
+  labelBits = qgramBits(sigma);
+  if (q * labelBits > 8 * sizeof(QGram)) {
+    printf("Path labels of %u nodes with %u labels do not fit in %zu bits\n", q, sigma,
+           8 * sizeof(QGram));
+    return false;
+  }
+  return true;
 }
 
 // Path label
-string L(vector<int> P) {
-  string l = "";
-  for (size_t i = 0; i < P.size(); i++) l += label[P[i]];
+QGram L(const int *P, size_t k) {
+  QGram l = 0;
+  for (size_t i = 0; i < k; i++) l = qgramPush(l, label[P[i]], labelBits);
   return l;
 }
 
+QGram L(const vector<int> &P) { return L(P.data(), P.size()); }
+
 // bruteforce
-set<string> dict;
-map<pair<int, string>, ll> freqBrute;
+QGramSet dict;
+StartQGramCount freqBrute;
 
 vector<int> P[30];
-string Pstring[30];
+QGram Pgram[30];
 set<int> Pset[30];
 
 void dfs(int t, int u, int k) {
   if (Pset[t].find(u) != Pset[t].end()) return;
 
   Pset[t].insert(u);
-  Pstring[t].push_back(label[u]);
+  Pgram[t] = qgramPush(Pgram[t], label[u], labelBits);
   P[t].push_back(u);
 
   if (k == 0) {
     #pragma omp critical
     {
-      dict.insert(Pstring[t]);
-      freqBrute[make_pair(*P[t].begin(), Pstring[t])]++;
+      dict.insert(Pgram[t]);
+      freqBrute[make_pair(*P[t].begin(), Pgram[t])]++;
     }
   } else {
     for (int v : G[u]) dfs(t, v, k - 1);
   }
   Pset[t].erase(u);
-  Pstring[t].pop_back();
+  Pgram[t] = qgramPop(Pgram[t], labelBits);
   P[t].pop_back();
 }
 
-// Dynamic Programming
-map<COLORSET, ll> *M[MAXQ + 1];
+// Dynamic Programming: M[i][c] (or MD[i][c]) is level i for coloring c.
+// Every coloring gives an independent colorful-path count; the estimators
+// sample from and sum over all of them.
+vector<DPLayer<COLORSET>> M[MAXQ + 1];
+
+// Dense DP: one flat array per level indexed by (node, colorset rank), where
+// the rank of a colorset is its position among the subsets of the same size
+bool dense_dp = false;
+unsigned int dense_q = 8;
+vector<ll *> MD[MAXQ + 1];
+size_t binom[MAXQ + 1];
+COLORSET *unrank[MAXQ + 1];
+unsigned int *rankOf;
+
+void initRank() {
+  rankOf = new unsigned int[1 << q];
+  for (unsigned int i = 0; i <= q; i++) binom[i] = 0;
+  for (unsigned int s = 0; s < (1u << q); s++)
+    rankOf[s] = binom[__builtin_popcount(s)]++;
+  for (unsigned int i = 0; i <= q; i++) unrank[i] = new COLORSET[binom[i]];
+  for (unsigned int s = 0; s < (1u << q); s++)
+    unrank[__builtin_popcount(s)][rankOf[s]] = (COLORSET)s;
+}
 
-void processDP() {
-  #pragma omp parallel for schedule(guided)
-  for (unsigned int u = 0; u < N; u++) M[1][u][setBit(0, color[u])] = 1ll;
+void initDenseDP() {
+  initRank();
+  for (unsigned int i = 1; i <= q; i++) {
+    MD[i].resize(colorings);
+    for (unsigned int c = 0; c < colorings; c++)
+      MD[i][c] = dpPlacement() ? numaAlloc<ll>((size_t)N * binom[i])
+                               : new ll[(size_t)N * binom[i]]();
+  }
+}
+
+// Number of paths of length i ending in u using exactly the colors in s,
+// with the c-th coloring
+inline ll getDP(unsigned int c, unsigned int i, int u, COLORSET s) {
+  if (dense_dp) return MD[i][c][(size_t)u * binom[i] + rankOf[s]];
+  return M[i][c].get(u, s);
+}
+
+// Number of non-zero entries of M[i][c][u]
+size_t sizeDP(unsigned int c, unsigned int i, int u) {
+  if (!dense_dp) return M[i][c].size(u);
+  size_t cnt = 0;
+  ll *row = MD[i][c] + (size_t)u * binom[i];
+  for (size_t r = 0; r < binom[i]; r++)
+    if (row[r]) cnt++;
+  return cnt;
+}
+
+// Add to rows[c] the paths of level i ending in u through the neighbours
+// vb..ve; one scan of the neighbours updates the tables of all colorings
+void denseRows(unsigned int i, unsigned int u, const int *vb, const int *ve,
+               ll *const *rows) {
+  for (const int *v = vb; v != ve; v++) {
+    for (unsigned int c = 0; c < colorings; c++) {
+      int cu = colorsOf(c)[u];
+      ll *row = rows[c];
+      ll *rowv = MD[i - 1][c] + (size_t)*v * binom[i - 1];
+      for (size_t r = 0; r < binom[i - 1]; r++) {
+        if (!rowv[r]) continue;
+        COLORSET s = unrank[i - 1][r];
+        if (getBit(s, cu)) continue;
+        row[rankOf[setBit(s, cu)]] += rowv[r];
+      }
+    }
+  }
+}
+
+void processDenseDP() {
+  // Every neighbour row costs the same, split the arcs evenly; the
+  // neighbours of a hub go in chunks to partial rows, summed at the end
+  DPSchedule S = makeSchedule(G, N, [](int) { return (uint64_t)1; });
+  size_t parts = S.parts();
+
+  #pragma omp parallel for schedule(runtime)
+  for (size_t t = 0; t < S.tasks.size(); t++) {
+    const DPTask &T = S.tasks[t];
+    if (T.part >= 0 && T.b != G.off[T.u]) continue;
+    for (unsigned int u = T.u; u < T.uEnd; u++)
+      for (unsigned int c = 0; c < colorings; c++)
+        MD[1][c][(size_t)u * binom[1] + rankOf[setBit(0, colorsOf(c)[u])]] = 1ll;
+  }
 
   for (unsigned int i = 2; i <= q; i++) {
-    #pragma omp parallel for schedule(guided)
-    for (unsigned int u = 0; u < N; u++) {
-      for (int v : G[u]) {
-        for (auto d : M[i - 1][v]) {
-          COLORSET s = d.first;
-          ll f = d.second;
-          if (getBit(s, color[u])) continue;
-          ll fp = M[i][u][setBit(s, color[u])];
-          M[i][u][setBit(s, color[u])] = f + fp;
+    vector<ll> part(parts * colorings * binom[i], 0ll);
+
+    #pragma omp parallel
+    {
+      vector<ll *> rows(colorings);
+
+      #pragma omp for schedule(runtime)
+      for (size_t t = 0; t < S.tasks.size(); t++) {
+        const DPTask &T = S.tasks[t];
+        if (T.part >= 0) {
+          for (unsigned int c = 0; c < colorings; c++)
+            rows[c] = &part[((size_t)T.part * colorings + c) * binom[i]];
+          denseRows(i, T.u, G.adj + T.b, G.adj + T.e, rows.data());
+          continue;
+        }
+        for (unsigned int u = T.u; u < T.uEnd; u++) {
+          for (unsigned int c = 0; c < colorings; c++)
+            rows[c] = MD[i][c] + (size_t)u * binom[i];
+          denseRows(i, u, G[u].begin(), G[u].end(), rows.data());
         }
       }
+
+      #pragma omp for schedule(dynamic, 1)
+      for (size_t h = 0; h < S.hubs.size(); h++)
+        for (unsigned int c = 0; c < colorings; c++) {
+          ll *row = MD[i][c] + (size_t)S.hubs[h] * binom[i];
+          for (size_t p = S.hubParts[h]; p < S.hubParts[h + 1]; p++) {
+            const ll *pr = &part[(p * colorings + c) * binom[i]];
+            for (size_t r = 0; r < binom[i]; r++) row[r] += pr[r];
+          }
+        }
     }
   }
 }
 
-bool isPrefix(set<string> W, string x) {
-  auto it = W.lower_bound(x);
-  if (it == W.end()) return false;
-  return mismatch(x.begin(), x.end(), (*it).begin()).first == x.end();
+void processDP() {
+  if (dense_dp) {
+    processDenseDP();
+    return;
+  }
+
+  for (unsigned int i = 1; i <= q; i++) M[i].resize(colorings);
+  for (unsigned int c = 0; c < colorings; c++) initLayer(M[1][c], N, colorsOf(c));
+  for (unsigned int i = 2; i <= q; i++)
+    buildLayers(M[i].data(), M[i - 1].data(), colorings, N, G, color);
+}
+
+// Save the DP table (and the colorings it was built with) to filename
+bool saveDP(const char *filename) {
+  size_t colorBytes = colorings * sizeof(int);
+  DPHeader h = makeDPHeader(q, G, color, colorBytes, sizeof(COLORSET), dense_dp);
+  DPFileWriter w(filename, h, color);
+  for (unsigned int i = 1; i <= q; i++)
+    for (unsigned int c = 0; c < colorings; c++) {
+      if (dense_dp)
+        w.write(MD[i][c], (size_t)N * binom[i] * sizeof(ll));
+      else
+        writeLayer(w, M[i][c], N);
+    }
+  return w.close();
 }
 
-map<string, ll> processFrequency(set<string> W, multiset<int> X) {
-  set<string> WR;
-  for (string w : W) {
-    reverse(w.begin(), w.end());
-    WR.insert(w);
+// Map the DP table saved by saveDP, if it was built for the same graph, q
+// and coloring. The table is used in place, dense or sparse as it was saved.
+bool loadDP(const char *filename) {
+  DPFile f;
+  if (!f.open(filename)) return false;
+  if (!f.matches(q, G, color, colorings * sizeof(int), sizeof(COLORSET))) {
+    printf("DP file %s was built for a different graph, q or coloring\n", filename);
+    return false;
   }
+  dense_dp = f.h.flags & DP_DENSE;
+  if (dense_dp) initRank();
+  for (unsigned int i = 1; i <= q; i++) {
+    M[i].resize(colorings);
+    MD[i].resize(colorings);
+    for (unsigned int c = 0; c < colorings; c++) {
+      if (dense_dp) {
+        MD[i][c] = f.next<ll>((size_t)N * binom[i]);
+        if (MD[i][c] == NULL) return false;
+      } else if (!mapLayer(f, M[i][c], N))
+        return false;
+    }
+  }
+  return true;
+}
 
-  vector<tuple<int, string, COLORSET>> old;
-
-  for (int x : X)
-  if (isPrefix(WR, string(&label[x], 1)))
-  old.push_back(make_tuple(x, string(&label[x], 1), setBit(0ll, color[x])));
+// A state of the f-count frontier: the partial paths from source src ending
+// in u, in state s of the trie, with colors cs; n is the number of such paths
+struct FrontierRow {
+  int u;
+  uint32_t s;
+  COLORSET cs;
+  int src;
+  ll n;
+  bool operator<(const FrontierRow &o) const {
+    if (u != o.u) return u < o.u;
+    if (s != o.s) return s < o.s;
+    if (cs != o.cs) return cs < o.cs;
+    return src < o.src;
+  }
+  bool sameState(const FrontierRow &o) const {
+    return u == o.u && s == o.s && cs == o.cs && src == o.src;
+  }
+};
+
+// Merge the rows of the same state, adding their paths. The rows are
+// bucketed by node (counting sort), and every bucket sorted on its own.
+void compactFrontier(vector<FrontierRow> &F) {
+  vector<size_t> start(N + 1, 0);
+  for (const FrontierRow &r : F) start[r.u + 1]++;
+  for (unsigned int u = 0; u < N; u++) start[u + 1] += start[u];
+  vector<FrontierRow> S(F.size());
+  vector<size_t> kept(start.begin(), start.end() - 1);
+  for (const FrontierRow &r : F) S[kept[r.u]++] = r;
 
-  for (int i = q - 1; i > 0; i--) {
-    vector<tuple<int, string, COLORSET>> current;
-    current.clear();
-    #pragma omp parallel for schedule(guided)
-    for (int j = 0; j < (int)old.size(); j++) {
-      auto o = old[j];
-      int u = get<0>(o);
-      string LP = get<1>(o);
-      COLORSET CP = get<2>(o);
-      for (int v : G[u]) {
-        if (getBit(CP, color[v])) continue;
-        COLORSET CPv = setBit(CP, color[v]);
-        string LPv = LP + label[v];
-        if (!isPrefix(WR, LPv)) continue;
-        #pragma omp critical
-        { current.push_back(make_tuple(v, LPv, CPv)); }
-      }
+  #pragma omp parallel for schedule(guided)
+  for (int u = 0; u < (int)N; u++) {
+    if (start[u + 1] - start[u] < 2) continue;
+    sort(S.begin() + start[u], S.begin() + start[u + 1]);
+    size_t k = start[u];
+    for (size_t j = start[u]; j < start[u + 1]; j++) {
+      if (k > start[u] && S[k - 1].sameState(S[j]))
+        S[k - 1].n += S[j].n;
+      else
+        S[k++] = S[j];
     }
-    old = current;
+    kept[u] = k;
   }
 
-  map<string, ll> frequency;
-  for (auto c : old) {
-    string s = get<1>(c);
-    reverse(s.begin(), s.end());
-    frequency[s]++;
+  F.clear();
+  for (unsigned int u = 0; u < N; u++)
+    F.insert(F.end(), S.begin() + start[u], S.begin() + kept[u]);
+}
+
+// Colorful paths from X with label in W, summed over the colorings (the sum
+// is colorings * q!/q^q times an unbiased estimate of the number of paths,
+// BCW and FJW do not depend on the scale). The paths grow from X one node
+// at a time, every partial path carrying its state in the trie of the
+// reversed labels of W, and stop when no label of W ends with their label.
+// The partial paths of the same node, trie state, colors and source are one
+// row of the frontier, so the work grows with the states, not with the paths.
+// X holds the start nodes and their sources (0..sources-1): one expansion
+// gives the frequencies of the paths from every source.
+vector<QGramCount> processFrequency(const QGramSet &W, const vector<pair<int, int>> &X,
+                                    unsigned int sources) {
+  LabelTrie T(W, q, labelBits, true);
+  vector<ll> count((size_t)sources * T.size(), 0);
+  for (unsigned int c = 0; c < colorings; c++) {
+    int *col = colorsOf(c);
+    vector<FrontierRow> old;
+
+    for (auto &x : X) {
+      uint32_t s = T.step(T.root(), label[x.first]);
+      if (s != LabelTrie::NONE) old.push_back({x.first, s, setBit(0, col[x.first]), x.second, 1});
+    }
+    compactFrontier(old);
+
+    for (int i = q - 1; i > 0; i--) {
+      vector<FrontierRow> current;
+      expandFrontier(old.size(), current, [&](size_t j, vector<FrontierRow> &out) {
+        const FrontierRow &o = old[j];
+        for (int v : G[o.u]) {
+          if (getBit(o.cs, col[v])) continue;
+          uint32_t sv = T.step(o.s, label[v]);
+          if (sv == LabelTrie::NONE) continue;
+          out.push_back({v, sv, setBit(o.cs, col[v]), o.src, o.n});
+        }
+      });
+      compactFrontier(current);
+      old.swap(current);
+    }
+
+    for (auto &o : old)
+      if (T.word(o.s) >= 0) count[(size_t)o.src * T.size() + T.word(o.s)] += o.n;
   }
+
+  vector<QGramCount> frequency(sources);
+  for (size_t w = 0; w < count.size(); w++)
+    if (count[w] > 0) frequency[w / T.size()][T.label(w % T.size())] = count[w];
   return frequency;
 }
 
-vector<int> randomPathTo(int u) {
-  list<int> P;
-  P.push_front(u);
-  COLORSET D = getCompl(setBit(0l, color[u]));
-  for (int i = q - 1; i > 0; i--) {
-    vector<ll> freq;
-    for (int v : G[u]) freq.push_back(M[i][v][D]);
-    discrete_distribution<int> distribution(freq.begin(), freq.end());
-    #pragma omp critical
-    {
-      u = G[u][distribution(eng)];
+// Frequencies of W in the paths from A and from B, and the paths from A or
+// B (Rp), in one expansion: the sources are the nodes of A only, of B only
+// and of both
+void processFrequencyAB(const QGramSet &W, const set<int> &A, const set<int> &B,
+                        QGramCount &freqA, QGramCount &freqB, long long &Rp) {
+  vector<pair<int, int>> X;
+  for (int a : A) X.push_back(make_pair(a, B.count(a) ? 2 : 0));
+  for (int b : B)
+    if (!A.count(b)) X.push_back(make_pair(b, 1));
+  vector<QGramCount> f = processFrequency(W, X, 3);
+  freqA.clear();
+  freqB.clear();
+  Rp = 0;
+  for (int k = 0; k < 3; k++)
+    for (auto &w : f[k]) {
+      Rp += w.second;
+      if (k != 1) freqA[w.first] += w.second;
+      if (k != 0) freqB[w.first] += w.second;
+    }
+}
+
+// Steps of colorfulPaths, cached by every thread across the samples (until
+// updateDP changes the DP)
+vector<PathSampler> samplers;
+
+// Random stream of the next sample: sample s draws from Philox(seed, s) only,
+// so that the samples of a seed are the same whatever the number of threads
+uint64_t sampleStream = 0;
+
+// Call f(colorset, paths) on the non-zero entries of M[i][c][u]
+template <typename F>
+void forEachDP(unsigned int c, unsigned int i, int u, F f) {
+  if (dense_dp) {
+    const ll *row = MD[i][c] + (size_t)u * binom[i];
+    for (size_t r = 0; r < binom[i]; r++)
+      if (row[r]) f(unrank[i][r], row[r]);
+  } else {
+    const DPLayer<COLORSET> &L = M[i][c];
+    for (uint64_t e = L.off[u]; e < L.end[u]; e++) f(L.cs[e], L.cnt[e]);
+  }
+}
+
+// Changes of a DP level: (node, coloring) -> colorset -> paths added
+typedef map<pair<int, unsigned int>, map<COLORSET, ll>> DPDelta;
+
+// Add the changes D to level i: in place for the dense table, by rewriting
+// the changed rows for the sparse one
+void applyDelta(unsigned int i, const DPDelta &D) {
+  if (dense_dp) {
+    for (auto &d : D) {
+      ll *row = MD[i][d.first.second] + (size_t)d.first.first * binom[i];
+      for (auto &w : d.second) row[rankOf[w.first]] += w.second;
     }
-    P.push_front(u);
-    D = clearBit(D, color[u]);
+    return;
+  }
+  for (unsigned int c = 0; c < colorings; c++) {
+    vector<int> nodes;
+    vector<vector<COLORSET>> cs;
+    vector<vector<ll>> cnt;
+    for (auto &d : D) {
+      if (d.first.second != c) continue;
+      map<COLORSET, ll> row = d.second;
+      forEachDP(c, i, d.first.first, [&](COLORSET s, ll f) { row[s] += f; });
+      nodes.push_back(d.first.first);
+      cs.push_back(vector<COLORSET>());
+      cnt.push_back(vector<ll>());
+      for (auto &w : row)
+        if (w.second != 0) {
+          cs.back().push_back(w.first);
+          cnt.back().push_back(w.second);
+        }
+    }
+    if (!nodes.empty()) replaceRows(M[i][c], N, nodes, cs, cnt);
   }
-  vector<int> ret;
-  ret.clear();
-  ret = vector<int>(begin(P), end(P));
-  return ret;
 }
 
-set<string> randomColorfulSample(vector<int> X, int r) {
-  set<string> W;
-  set<vector<int>> R;
-  vector<ll> freqX;
-  for (int x : X) freqX.push_back(M[q][x][getCompl(0ll)]);
-  discrete_distribution<int> distribution(freqX.begin(), freqX.end());
-  while (R.size() < (size_t)r) {
-    int u = X[distribution(eng)];
-    vector<int> P = randomPathTo(u);
-    if (R.find(P) == R.end()) R.insert(P);
+// Apply a batch of edge insertions and deletions (node pairs) to G and
+// update the DP table to match, instead of processDP(). The row of u at
+// level i changes by the level i-1 rows of its inserted neighbours, minus
+// those of its deleted ones, plus the changes of all its neighbours at level
+// i-1: the changes spread from the endpoints one hop per level, and only
+// the changed rows are touched. The changes of level i are found with level
+// i-1 as it was, then applied. The cached sampler steps are dropped. False,
+// with nothing changed, if a deleted edge is missing.
+bool updateDP(const vector<int> &ins, const vector<int> &del) {
+  if (!updateCSR(G, ins, del)) return false;
+
+  vector<pair<pair<int, int>, int>> arcs;  // (u, v), +1 inserted or -1 deleted
+  for (size_t e = 0; e + 1 < ins.size(); e += 2) {
+    arcs.push_back(make_pair(make_pair(ins[e], ins[e + 1]), 1));
+    arcs.push_back(make_pair(make_pair(ins[e + 1], ins[e]), 1));
   }
-  for (auto r : R) {
-    reverse(r.begin(), r.end());
-    W.insert(L(r));
+  for (size_t e = 0; e + 1 < del.size(); e += 2) {
+    arcs.push_back(make_pair(make_pair(del[e], del[e + 1]), -1));
+    arcs.push_back(make_pair(make_pair(del[e + 1], del[e]), -1));
   }
-  return W;
+
+  DPDelta prev, cur;
+  for (unsigned int i = 2; i <= q; i++) {
+    cur.clear();
+    for (auto &a : arcs) {
+      int u = a.first.first, v = a.first.second, sign = a.second;
+      for (unsigned int c = 0; c < colorings; c++) {
+        int cu = colorsOf(c)[u];
+        map<COLORSET, ll> &d = cur[make_pair(u, c)];
+        forEachDP(c, i - 1, v, [&](COLORSET s, ll f) {
+          if (!getBit(s, cu)) d[setBit(s, cu)] += sign * f;
+        });
+      }
+    }
+    for (auto &p : prev) {
+      unsigned int c = p.first.second;
+      for (int u : G[p.first.first]) {
+        int cu = colorsOf(c)[u];
+        map<COLORSET, ll> &d = cur[make_pair(u, c)];
+        for (auto &w : p.second)
+          if (!getBit(w.first, cu)) d[setBit(w.first, cu)] += w.second;
+      }
+    }
+    applyDelta(i - 1, prev);
+    prev.swap(cur);
+  }
+  applyDelta(q, prev);
+
+  for (PathSampler &S : samplers) S.clear();
+  return true;
 }
 
-map<pair<int, string>, ll> randomColorfulSamplePlus(vector<int> X, int r) {
-  map<pair<int, string>, ll> W;
-  set<vector<int>> R;
+// Colorful paths of every coloring, weighted by count: the start (coloring,
+// node) is drawn among colorings * |X| pairs
+vector<ll> colorfulFrequency(const vector<int> &X) {
   vector<ll> freqX;
-  freqX.clear();
-  for (int x : X) freqX.push_back(M[q][x][getCompl(0ll)]);
-  discrete_distribution<int> distribution(freqX.begin(), freqX.end());
-  while( R.size() < (size_t)r)
-  {
-    int rem = r - R.size();
-    // #pragma omp parallel for schedule(guided)
-    for(int i=0; i<rem; i++)
-    {
-      int u;
-//      #pragma omp critical
-//      {
-        u = X[distribution(eng)];
-//      }
-      vector<int> P = randomPathTo(u);
-      // #pragma omp critical
-      // {
-        R.insert(P);
-      // }
+  for (unsigned int c = 0; c < colorings; c++)
+    for (int x : X) freqX.push_back(getDP(c, q, x, getCompl(0ll)));
+  return freqX;
+}
+
+// n uniform colorful paths, the start (coloring, node) of every path drawn
+// by start among colorings * |X| pairs. The paths are extended backwards
+// one level at a time, all together: the partial paths at the same step
+// (coloring, node, colors left) are grouped, and every group draws from one
+// step table, so the DP rows are read once per step and not once per path.
+// Every path still draws from its own stream, in the same order as alone.
+// The paths not in seen (fingerprints of the paths sampled so far) are
+// added to it and appended to paths, q nodes each from the start; all the
+// paths if not distinct (draws with replacement, seen is not used).
+void colorfulPaths(const vector<int> &X, const PathStep &start, size_t n,
+                   PathSet &seen, vector<int> &paths, bool distinct = true) {
+  vector<int> nodes(n * q);
+  vector<Philox> rng;
+  vector<PathFingerprint> fp(n);
+  vector<unsigned int> pc(n);
+  vector<COLORSET> left(n);
+  rng.reserve(n);
+  for (size_t s = 0; s < n; s++) rng.push_back(Philox(seed, sampleStream + s));
+  sampleStream += n;
+
+  #pragma omp parallel for schedule(static)
+  for (size_t s = 0; s < n; s++) {
+    int j = start.sample(rng[s]);
+    int u = X[j % X.size()];
+    pc[s] = j / X.size();
+    nodes[s * q + q - 1] = u;
+    fp[s].add(u);
+    left[s] = getCompl(setBit(0l, colorsOf(pc[s])[u]));
+  }
+
+  vector<size_t> order(n), groups;
+  for (size_t s = 0; s < n; s++) order[s] = s;
+  for (int i = q - 1; i > 0; i--) {
+    auto key = [&](size_t s) { return make_tuple(pc[s], nodes[s * q + i], left[s]); };
+    sort(order.begin(), order.end(),
+         [&](size_t a, size_t b) { return key(a) < key(b); });
+    groups.clear();
+    for (size_t k = 0; k < n; k++)
+      if (k == 0 || key(order[k]) != key(order[k - 1])) groups.push_back(k);
+    groups.push_back(n);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t g = 0; g < groups.size() - 1; g++) {
+      size_t s0 = order[groups[g]];
+      unsigned int c = pc[s0];
+      int u = nodes[s0 * q + i];
+      COLORSET D = left[s0];
+      const PathStep &S = samplers[omp_get_thread_num()].step(
+          G, (uint64_t)c * (MAXQ + 1) + i, u, D,
+          [&](int v) { return getDP(c, i, v, D); });
+      for (size_t k = groups[g]; k < groups[g + 1]; k++) {
+        size_t s = order[k];
+        int v = S.sample(rng[s]);
+        nodes[s * q + i - 1] = v;
+        fp[s].add(v);
+        left[s] = clearBit(D, colorsOf(c)[v]);
+      }
     }
   }
-  for (auto r : R) {
-    reverse(r.begin(), r.end());
-    W[make_pair(*r.begin(), L(r))]++;
+
+  vector<char> fresh(n, 1);
+  if (distinct) {
+    seen.reserve(n);
+    #pragma omp parallel for schedule(static)
+    for (size_t s = 0; s < n; s++) fresh[s] = seen.insert(fp[s]);
   }
+  for (size_t s = 0; s < n; s++)
+    if (fresh[s])
+      paths.insert(paths.end(), nodes.rbegin() + (n - s - 1) * q,
+                   nodes.rbegin() + (n - s) * q);
+}
+
+// Draws of the sampling batches after the first: a batch that finds no new
+// path among this many draws ends the sampling (X has fewer distinct paths)
+const size_t exhaustedBatch = 1000;
+
+// r distinct colorful paths from X, q nodes each, or all of them if X has
+// fewer: the first batch draws r paths, the next ones the paths missing but
+// at least exhaustedBatch, and the sampling stops at the first batch with no
+// new path
+void distinctColorfulPaths(const vector<int> &X, size_t r, vector<int> &paths) {
+  PathSet seen;
+  PathStep start = weightedChoice(colorfulFrequency(X));
+  if (start.cum.empty()) return;
+  size_t before;
+  do {
+    before = paths.size();
+    size_t missing = r - before / q;
+    colorfulPaths(X, start, before == 0 ? r : max(missing, exhaustedBatch), seen, paths);
+    if (paths.size() > r * q) paths.resize(r * q);
+  } while (paths.size() < r * q && paths.size() > before);
+}
+
+QGramSet randomColorfulSample(vector<int> X, int r) {
+  QGramSet W;
+  vector<int> paths;
+  distinctColorfulPaths(X, r, paths);
+  for (size_t p = 0; p < paths.size(); p += q) W.insert(L(&paths[p], q));
+  return W;
+}
+
+StartQGramCount randomColorfulSamplePlus(vector<int> X, int r) {
+  StartQGramCount W;
+  vector<int> paths;
+  distinctColorfulPaths(X, r, paths);
+  for (size_t p = 0; p < paths.size(); p += q)
+    W[make_pair(paths[p], L(&paths[p], q))]++;
   return W;
 }
 
-set<string> BCSampler(set<int> A, set<int> B, int r) {
+// fsample with early stopping: the colorful paths from X are drawn in
+// batches, and stop when the BCW (bc) or FJW of A and B is within +-epsilon
+// with confidence 1 - delta, when R paths are drawn, or when a batch draws
+// no new path (all the paths are in the sample: the bound is 0). Every batch
+// draws at least exhaustedBatch paths, the new ones past R are dropped.
+// Returns the paths used; estimate, halfWidth and labels are those of the
+// sample.
+size_t adaptiveColorfulSample(const vector<int> &X, const set<int> &A,
+                              const set<int> &B, bool bc, double &estimate,
+                              double &halfWidth, int &labels) {
+  StreamSimilarity S(bootstraps);
+  PathSet seen;
+  vector<int> paths;
+  PathStep start = weightedChoice(colorfulFrequency(X));
+  size_t used = 0;
+  halfWidth = INFINITY;
+  if (start.cum.empty()) halfWidth = 0;
+  while (used < R && halfWidth > epsilon) {
+    colorfulPaths(X, start, max(exhaustedBatch, used / 4), seen, paths);
+    if (paths.size() > (size_t)R * q) paths.resize((size_t)R * q);
+    if (paths.size() == used * q) {
+      halfWidth = 0;
+      break;
+    }
+    for (; used * q < paths.size(); used++) {
+      const int *P = &paths[used * q];
+      PathFingerprint f;
+      for (unsigned int j = 0; j < q; j++) f.add(P[j]);
+      S.add(L(P, q), A.count(P[0]), B.count(P[0]), f.a);
+    }
+    halfWidth = bc ? S.bcHalfWidth(delta) : S.fjHalfWidth(delta);
+  }
+  estimate = bc ? S.bc() : S.fj();
+  labels = S.labels();
+  return used;
+}
+
+// Sketch index of the labels of every node, from R colorful paths drawn
+// from each with replacement: the label counts of every node sum to R, and
+// estimate R times its label distribution, whatever the number of its paths
+SketchIndex buildSketchIndex() {
+  SketchIndex index(N, sketch_size, bands);
+  for (unsigned int u = 0; u < N; u++) {
+    vector<int> X(1, u);
+    PathStep start = weightedChoice(colorfulFrequency(X));
+    if (start.cum.empty()) continue;
+    PathSet seen;
+    vector<int> paths;
+    colorfulPaths(X, start, R, seen, paths, false);
+    vector<QGram> labels;
+    for (size_t p = 0; p < paths.size(); p += q)
+      labels.push_back(L(&paths[p], q));
+    index.add(u, labels);
+  }
+  index.build();
+  return index;
+}
+
+QGramSet BCSampler(set<int> A, set<int> B, int r) {
   vector<int> X;
   for (int a : A) X.push_back(a);
   for (int b : B) X.push_back(b);
   return randomColorfulSample(X, r);
 }
 
-vector<int> naiveRandomPathTo(int u) {
+vector<int> naiveRandomPathTo(int u, Philox &rng) {
   vector<int> P;
   set<int> Ps;
   P.push_back(u);
@@ -344,66 +832,146 @@ vector<int> naiveRandomPathTo(int u) {
     for (int j : G[u])
     if (Ps.find(j) == Ps.end()) Nu.push_back(j);
     if (Nu.size() == 0) return P;
-    int u;
-    #pragma omp critical
-    {
-      u = Nu[eng() % Nu.size()];
-    }
+    int u = Nu[rng() % Nu.size()];
     Ps.insert(u);
     P.push_back(u);
   }
   return P;
 }
 
-map<pair<int, string>, ll> baselineSampler(vector<int> X, int r) {
-  set<vector<int>> R;
+StartQGramCount baselineSampler(vector<int> X, int r) {
+  PathSet seen;
+  StartQGramCount fx;
+  size_t found = 0, before;
 
-  while( R.size() < (size_t)r)
+  // batches as in distinctColorfulPaths
+  do
   {
-    int rem = r - R.size();
+    before = found;
+    size_t rem = found == 0 ? r : max((size_t)r - found, exhaustedBatch);
+    vector<vector<int>> paths(rem);
+    vector<char> fresh(rem);
+    seen.reserve(rem);
     #pragma omp parallel for schedule(guided)
-    for(int i=0; i<rem; i++)
+    for(size_t i=0; i<rem; i++)
     {
-      int u;
-      #pragma omp critical
-      {
-        u = X[eng() % X.size()];
-      }
-      vector<int> P = naiveRandomPathTo(u);
-      #pragma omp critical
-      {
-        R.insert(P);
-      }
+      Philox rng(seed, sampleStream + i);
+      paths[i] = naiveRandomPathTo(X[rng() % X.size()], rng);
+      fresh[i] = seen.insert(pathFingerprint(paths[i]));
     }
-  }
-  map<pair<int, string>, ll> fx;
-  for (auto P : R) fx[make_pair(*P.begin(), L(P))]++;
+    sampleStream += rem;
+    // the walks stuck before q nodes are not q-paths (and their packed
+    // labels would equal those of longer labels)
+    for(size_t i=0; i<rem && found < (size_t)r; i++)
+      if (fresh[i] && paths[i].size() == q) {
+        fx[make_pair(paths[i][0], L(paths[i]))]++;
+        found++;
+      }
+  } while (found < (size_t)r && found > before);
   return fx;
 }
 
 
-double BCW(set<string> W, map<string, ll> freqA, map<string, ll> freqB) {
+double BCW(const QGramSet &W, const QGramCount &freqA, const QGramCount &freqB) {
   ll num = 0ll;
   ll den = 0ll;
-  for (string x : W) {
-    ll fax = freqA[x];
-    ll fbx = freqB[x];
+  for (QGram x : W) {
+    ll fax = qgramCount(freqA, x);
+    ll fbx = qgramCount(freqB, x);
     num += 2 * min(fax, fbx);
     den += fax + fbx;
   }
   return (double)num / (double)den;
 }
 
-double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB, long long R) {
+double FJW(const QGramSet &W, const QGramCount &freqA, const QGramCount &freqB, long long R) {
     ll num = 0ll;
-    for (string x : W) {
-      ll fax = freqA[x];
-      ll fbx = freqB[x];
+    for (QGram x : W) {
+      ll fax = qgramCount(freqA, x);
+      ll fbx = qgramCount(freqB, x);
       num += min(fax, fbx);
     }
     return (double)num / (double) R;
   }
 
+// The estimators of the similarity of A and B, on the paths from X (the
+// nodes of A, then of B) for Bray-Curtis and from ABv (the nodes of A or B)
+// for frequency Jaccard. The Bray-Curtis ones give the labels found (tau).
+
+// Bray-Curtis and frequency Jaccard of all the paths
+void bruteforceSimilarity(const set<int> &A, const set<int> &B,
+                          const vector<int> &ABv, double &bc, double &fj,
+                          int &tau) {
+  QGramCount freqA, freqB;
+  long long Rp = 0;
+  dict.clear();
+  freqBrute.clear();
+  #pragma omp parallel for schedule(guided)
+  for (int i = 0; i < (int)ABv.size(); i++) {
+    int tid = omp_get_thread_num();
+    dfs(tid, ABv[i], q - 1);
+  }
+  for (auto &w : freqBrute) {
+    int u = w.first.first;
+    QGram s = w.first.second;
+    ll freq = w.second;
+    Rp += freq;
+    if (A.find(u) != A.end()) freqA[s] += freq;
+    if (B.find(u) != B.end()) freqB[s] += freq;
+  }
+  tau = dict.size();
+  bc = BCW(dict, freqA, freqB);
+  fj = FJW(dict, freqA, freqB, Rp);
+}
+
+double fcountBC(const set<int> &A, const set<int> &B, const vector<int> &X,
+                int &tau) {
+  QGramCount freqA, freqB;
+  long long Rp;
+  QGramSet Sample = randomColorfulSample(X, R);
+  processFrequencyAB(Sample, A, B, freqA, freqB, Rp);
+  tau = Sample.size();
+  return BCW(Sample, freqA, freqB);
+}
+
+double fcountFJ(const set<int> &A, const set<int> &B, const vector<int> &ABv) {
+  QGramCount freqA, freqB;
+  long long Rp;
+  QGramSet Sample = randomColorfulSample(ABv, R);
+  processFrequencyAB(Sample, A, B, freqA, freqB, Rp);
+  return FJW(Sample, freqA, freqB, Rp);
+}
+
+// Estimate of the paths counted by start node and label (fsample, baseline)
+double sampleBC(const set<int> &A, const set<int> &B,
+                const StartQGramCount &Sample, int &tau) {
+  QGramCount freqA, freqB;
+  QGramSet W;
+  for (auto &w : Sample) {
+    int u = w.first.first;
+    W.insert(w.first.second);
+    if (A.find(u) != A.end()) freqA[w.first.second] += w.second;
+    if (B.find(u) != B.end()) freqB[w.first.second] += w.second;
+  }
+  tau = W.size();
+  return BCW(W, freqA, freqB);
+}
+
+double sampleFJ(const set<int> &A, const set<int> &B,
+                const StartQGramCount &Sample) {
+  QGramCount freqA, freqB;
+  QGramSet W;
+  long long Rp = 0;
+  for (auto &w : Sample) {
+    int u = w.first.first;
+    W.insert(w.first.second);
+    Rp += w.second;
+    if (A.find(u) != A.end()) freqA[w.first.second] += w.second;
+    if (B.find(u) != B.end()) freqB[w.first.second] += w.second;
+  }
+  return FJW(W, freqA, freqB, Rp);
+}
+
   vector<int> sampleV;
   set<int> randomChoose(int s, int mod)
   {
@@ -446,7 +1014,7 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB, long lon
       printf("Valid arguments:\n");
 
       printf("-g, --input filename\n");
-      printf("\tInput file of labeled graph in nmle format (default stdin)\n");
+      printf("\tInput file of labeled graph in nme.bin or csr format (default stdin)\n");
 
       printf("-p, --parallel threadcount\n");
       printf("\tNumber of threads to use (default maximum thread avaiable)\n");
@@ -473,6 +1041,56 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB, long lon
       printf("-E, --experiment number\n");
       printf("\tNumber of experiments\n");
 
+      printf("-C, --colorings number\n");
+      printf("\tNumber of independent colorings, combined in the estimates (default 1)\n");
+
+      printf("-D, --dense number\n");
+      printf("\tUse dense DP tables when Q <= number (default 8, 0=never)\n");
+
+      printf("--save-dp filename\n");
+      printf("\tSave the DP table to filename\n");
+
+      printf("--load-dp filename\n");
+      printf("\tLoad the DP table from filename instead of computing it\n");
+
+      printf("--order none|degree|rcm|slashburn\n");
+      printf("\tRelabel the nodes for memory locality before the DP (default none)\n");
+
+      printf("--epsilon number\n");
+      printf("\tStop f-sample when its estimates are within +-number with confidence\n");
+      printf("\t1 - delta, R being the maximum sample size (default 0, fixed R)\n");
+
+      printf("--delta number\n");
+      printf("\tConfidence of --epsilon (default 0.05)\n");
+
+      printf("--index\n");
+      printf("\tSketch the path labels of every node from R paths each and print the\n");
+      printf("\ttop nodes most similar to the nodes of --query (default all the nodes)\n");
+
+      printf("--query u,v,...\n");
+      printf("\tNodes whose most similar nodes --index prints\n");
+
+      printf("--sketch number\n");
+      printf("\tHashes of the sketch of a node (default 64)\n");
+
+      printf("--bands number\n");
+      printf("\tLSH bands of the sketches, a divisor of --sketch (default 16)\n");
+
+      printf("--top number\n");
+      printf("\tSimilar nodes printed per query (default 10)\n");
+
+      printf("--serve\n");
+      printf("\tKeep the graph and the DP table and answer the queries read from stdin\n");
+      printf("\t(or --socket), one per line, answered in batches of the lines read together:\n");
+      printf("\t  bruteforce|fcount|fsample|baseline R A B -> algorithm,BC,FJ,TAU,TIME\n");
+      printf("\t  top T u -> top,u,v1,sim1,...  (with --index)\n");
+      printf("\t  update +u,v -u,v ... -> update,INSERTED,DELETED,TIME\n");
+      printf("\twith A and B lists of nodes u,v,...; update inserts and deletes edges and\n");
+      printf("\tupdates the DP table (not the sketch index); the line quit stops the server\n");
+
+      printf("--socket filename\n");
+      printf("\tServe the queries on the Unix socket filename instead of stdin\n");
+
       printf("--bruteforce\n");
       printf("\tExecute bruteforce algorithm\n");
 
@@ -488,12 +1106,21 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB, long lon
       printf("--help\n");
       printf("\tDisplay help text and exit.\n");
 
+      printf("--numa\n");
+      printf("\tPin the threads and place the graph and the DP rows on the NUMA node\n");
+      printf("\tof the threads processing them; print the DP traffic of every node\n");
+
       printf("--verbose\n");
       printf("\tPrint status messages.\n");
     }
 
     bool input_graph_flag = false;
     char *input_graph = NULL;
+    char *save_dp = NULL;
+    char *load_dp = NULL;
+    char *order_by = NULL;
+    char *socket_path = NULL;
+    char *query_nodes = NULL;
 
     long long current_timestamp() {
       struct timeval te;
@@ -502,6 +1129,121 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB, long lon
       return milliseconds;
     }
 
+// Nodes "u,v,..." of a query, with the ids of the input graph
+bool parseNodes(const string &s, set<int> &S) {
+  for (size_t i = 0; i <= s.size();) {
+    size_t j = min(s.find(',', i), s.size());
+    char *end;
+    long u = strtol(s.c_str() + i, &end, 10);
+    if (j == i || end != s.c_str() + j || u < 0 || u >= (long)N) return false;
+    S.insert(u);
+    i = j + 1;
+  }
+  return true;
+}
+
+// Node u of the input graph in the (reordered) graph
+int nodeId(int u) { return newId.empty() ? u : newId[u]; }
+
+// Nodes of the input graph in the (reordered) graph
+set<int> nodeIds(const set<int> &S) {
+  set<int> T;
+  for (int u : S) T.insert(nodeId(u));
+  return T;
+}
+
+// Answer to a query of --serve, nodes with the ids of the input graph:
+//   bruteforce|fcount|fsample|baseline R A B -> algorithm,BC,FJ,TAU,TIME
+//   top T u                                  -> top,u,v1,sim1,...,vT,simT
+//   update +u,v -u,v ...                     -> update,INSERTED,DELETED,TIME
+// A and B are lists of nodes "u,v,..."; update inserts (+) and deletes (-)
+// edges (see updateDP). The query number n draws from the random streams
+// n << 32 on, so its answer does not depend on the others.
+string answerQuery(const string &line, const SketchIndex &index,
+                   const vector<int> &oldId, uint64_t n) {
+  istringstream in(line);
+  string algorithm, a, b;
+  long r;
+  char buf[64];
+  if (!(in >> algorithm)) return "error,malformed query";
+
+  if (algorithm == "update") {
+    vector<int> ins, del;
+    string e;
+    while (in >> e) {
+      set<int> uv;
+      if ((e[0] != '+' && e[0] != '-') || !parseNodes(e.substr(1), uv) || uv.size() != 2)
+        return "error,wrong edge " + e;
+      vector<int> &to = e[0] == '+' ? ins : del;
+      for (int u : uv) to.push_back(nodeId(u));
+    }
+    ll time = current_timestamp();
+    if (!updateDP(ins, del)) return "error,missing edge";
+    time = current_timestamp() - time;
+    snprintf(buf, sizeof(buf), ",%zu,%zu,%lld", ins.size() / 2, del.size() / 2, time);
+    return algorithm + buf;
+  }
+
+  if (!(in >> r >> a) || r <= 0) return "error,malformed query";
+
+  if (algorithm == "top") {
+    set<int> U;
+    if (!parseNodes(a, U) || U.size() != 1) return "error,wrong node";
+    if (index.size() == 0) return "error,no sketch index (--index)";
+    int u = nodeId(*U.begin());
+    string out = "top," + to_string(oldId[u]);
+    for (auto &w : index.top(u, r)) {
+      snprintf(buf, sizeof(buf), ",%d,%.6f", oldId[w.first], w.second);
+      out += buf;
+    }
+    return out;
+  }
+
+  // X and ABv in the order of the input ids, as in the batch mode, so the
+  // start nodes drawn (and the answer) do not depend on --order
+  set<int> A, B;
+  if (!(in >> b)) return "error,malformed query";
+  if (!parseNodes(a, A) || !parseNodes(b, B)) return "error,wrong node";
+  vector<int> X(A.begin(), A.end());
+  X.insert(X.end(), B.begin(), B.end());
+  set<int> AB(A);
+  AB.insert(B.begin(), B.end());
+  vector<int> ABv(AB.begin(), AB.end());
+  for (int &u : X) u = nodeId(u);
+  for (int &u : ABv) u = nodeId(u);
+  A = nodeIds(A);
+  B = nodeIds(B);
+
+  unsigned int r0 = R;
+  R = r;
+  sampleStream = n << 32;
+  double bc = 0, fj = 0, halfWidth;
+  int tau = 0, tau_fj;
+  ll time = current_timestamp();
+  if (algorithm == "bruteforce")
+    bruteforceSimilarity(A, B, ABv, bc, fj, tau);
+  else if (algorithm == "fcount") {
+    bc = fcountBC(A, B, X, tau);
+    fj = fcountFJ(A, B, ABv);
+  } else if (algorithm == "fsample" && epsilon > 0) {
+    adaptiveColorfulSample(X, A, B, true, bc, halfWidth, tau);
+    adaptiveColorfulSample(ABv, A, B, false, fj, halfWidth, tau_fj);
+  } else if (algorithm == "fsample") {
+    bc = sampleBC(A, B, randomColorfulSamplePlus(X, R), tau);
+    fj = sampleFJ(A, B, randomColorfulSamplePlus(ABv, R));
+  } else if (algorithm == "baseline") {
+    bc = sampleBC(A, B, baselineSampler(X, R), tau);
+    fj = sampleFJ(A, B, baselineSampler(ABv, R));
+  } else {
+    R = r0;
+    return "error,unknown algorithm " + algorithm;
+  }
+  time = current_timestamp() - time;
+  R = r0;
+  snprintf(buf, sizeof(buf), ",%.6f,%.6f,%d,%lld", bc, fj, tau, time);
+  return algorithm + buf;
+}
+
 int main(int argc, char **argv) {
       static struct option long_options[] = {
 
@@ -517,6 +1259,18 @@ int main(int argc, char **argv) {
         {     "bsize", required_argument, 0, 'B'},
         {  "modality", required_argument, 0, 'M'},
         {"experiment", required_argument, 0, 'E'},
+        {     "dense", required_argument, 0, 'D'},
+        { "colorings", required_argument, 0, 'C'},
+        {   "save-dp", required_argument, 0, 's'},
+        {   "load-dp", required_argument, 0, 'l'},
+        {     "order", required_argument, 0, 'o'},
+        {   "epsilon", required_argument, 0, 'e'},
+        {     "delta", required_argument, 0, 'd'},
+        {    "sketch", required_argument, 0, 'K'},
+        {     "bands", required_argument, 0, 'b'},
+        {       "top", required_argument, 0, 't'},
+        {    "socket", required_argument, 0, 'u'},
+        {     "query", required_argument, 0, 'y'},
 
         // Info flag
         {   "help", no_argument, &help_flag   , 1},
@@ -527,6 +1281,9 @@ int main(int argc, char **argv) {
         {"fcount"    , no_argument, &fcount_flag, 1},
         {"fsample"   , no_argument, &fsample_flag, 1},
         {"baseline"  , no_argument, &baseline_flag, 1},
+        {"numa"      , no_argument, &numa_flag, 1},
+        {"index"     , no_argument, &index_flag, 1},
+        {"serve"     , no_argument, &serve_flag, 1},
 
         {0, 0, 0, 0}
       };
@@ -534,7 +1291,7 @@ int main(int argc, char **argv) {
       int option_index = 0;
       int c;
       while (1) {
-        c = getopt_long(argc, argv, "g:q:p:Q:S:R:A:B:M:E:", long_options, &option_index);
+        c = getopt_long(argc, argv, "g:q:p:Q:S:R:A:B:M:E:D:C:", long_options, &option_index);
 
         if (c == -1) break;
 
@@ -567,6 +1324,43 @@ int main(int argc, char **argv) {
           case 'E':
           if (optarg != NULL) experiment = atoi(optarg);
           break;
+          case 'D':
+          if (optarg != NULL) dense_q = atoi(optarg);
+          break;
+          case 'C':
+          if (optarg != NULL) colorings = atoi(optarg);
+          break;
+          case 's':
+          save_dp = optarg;
+          break;
+          case 'l':
+          load_dp = optarg;
+          break;
+          case 'o':
+          order_by = optarg;
+          break;
+          case 'e':
+          if (optarg != NULL) epsilon = atof(optarg);
+          break;
+          case 'd':
+          if (optarg != NULL) delta = atof(optarg);
+          break;
+          case 'K':
+          if (optarg != NULL) sketch_size = atoi(optarg);
+          break;
+          case 'b':
+          if (optarg != NULL) bands = atoi(optarg);
+          break;
+          case 't':
+          if (optarg != NULL) top = atoi(optarg);
+          break;
+          case 'u':
+          socket_path = optarg;
+          break;
+
+          case 'y':
+          query_nodes = optarg;
+          break;
         }
       }
 
@@ -586,11 +1380,37 @@ int main(int argc, char **argv) {
         return 1;
       }
 
+      if (colorings == 0) {
+        printf("Invalid number of colorings.\n");
+        return 1;
+      }
+
+      if (bands == 0 || sketch_size % bands != 0) {
+        printf("The sketch size must be a multiple of the bands.\n");
+        return 1;
+      }
+
       if (thread_count > 0 && (int)thread_count < omp_get_max_threads()) {
         omp_set_dynamic(0);
         omp_set_num_threads(thread_count);
       }
 
+      NumaTopology topology;
+      if (numa_flag) {
+        omp_set_dynamic(0);
+        topology = numaTopology();
+        threadNode = numaPinThreads(topology);
+        dpPlacement() = true;
+        if (verbose_flag) {
+          vector<int> threads(topology.nodes(), 0);
+          for (int nd : threadNode) threads[nd]++;
+          for (int nd = 0; nd < topology.nodes(); nd++)
+            printf("NUMA node %d: %zu CPUs | %d threads\n", nd,
+                   topology.cpus[nd].size(), threads[nd]);
+        }
+      }
+      samplers.resize(omp_get_max_threads());
+
       if (verbose_flag) {
         printf("Options:\n");
         printf("thread = %d\n", thread_count);
@@ -602,11 +1422,22 @@ int main(int argc, char **argv) {
         printf("B = %d\n", Sb);
         printf("M = %d\n", mod);
         printf("E = %d\n", experiment);
+        printf("C = %d\n", colorings);
       }
 
       if (verbose_flag) printf("Reading graph...\n");
 
-      if (input_graph_flag) {
+      if (input_graph_flag && input_graph != NULL && isCSRFile(input_graph)) {
+        // CSR graph file, mapped and used in place
+        const int *intLabel = NULL;
+        if (!mapCSR(input_graph, G, &intLabel, NULL)) return 1;
+        N = G.n;
+        E = G.arcs() / 2;
+        if (verbose_flag) printf("N = %d | E = %d\n", N, E);
+
+        if (!readLabels(intLabel)) return 1;
+
+      } else if (input_graph_flag) {
         if (input_graph == NULL) {
           printf("Input file name missing!\n");
           return 1;
@@ -621,54 +1452,73 @@ int main(int argc, char **argv) {
         read(input_fd, &E, sizeof(int));
         if (verbose_flag) printf("N = %d | E = %d\n", N, E);
 
-        label = new char[N + 1];
-        color = new int[N + 1];
         int *intLabel = new int[N + 1];
 
         if (verbose_flag) printf("Reading labels...\n");
         read(input_fd, intLabel, N * sizeof(int));
-        for (unsigned int i = 0; i < N; i++) label[i] = 'A' + intLabel[i];
+        if (!readLabels(intLabel)) return 1;
+        delete[] intLabel;
 
         if (verbose_flag) printf("Reading edges...\n");
-        G = new vector<int>[N + 1];
         int *ab = new int[2 * E];
         read(input_fd, ab, 2 * E * sizeof(int));
-        for (unsigned int i = 0; i < E; i++) {
-          G[ab[2 * i]].push_back(ab[2 * i + 1]);
-          G[ab[2 * i + 1]].push_back(ab[2 * i]);
-        }
-        free(ab);
+        buildCSR(G, N, ab, E);
+        delete[] ab;
 
       } else {
         // Read from stdin, nme format
-        N = nextInt();
-        E = nextInt();
+        vector<int> in;
+        if (!readTextInts(NULL, in) || in.size() < 2 ||
+            in.size() < 2 + (size_t)in[0] + 2 * (size_t)in[1]) {
+          printf("Error reading input graph\n");
+          return 1;
+        }
+        N = in[0];
+        E = in[1];
         if (verbose_flag) printf("N = %d | E = %d\n", N, E);
 
-        label = new char[N + 1];
-        color = new int[N + 1];
-        G = new vector<int>[N + 1];
-
         if (verbose_flag) printf("Reading labels...\n");
-        for (unsigned int i = 0; i < N; i++) label[i] = 'A' + nextInt();
+        if (!readLabels(in.data() + 2)) return 1;
 
         if (verbose_flag) printf("Reading edges...\n");
-        for (unsigned int i = 0; i < E; i++) {
-          int a = nextInt();
-          int b = nextInt();
-          G[a].push_back(b);
-          G[b].push_back(a);
-        }
+        buildCSR(G, N, in.data() + 2 + N, E);
       }
 
       if (verbose_flag) printf("N = %d | E = %d\n", N, E);
 
+      // Relabel the nodes; the nodes chosen by id (A, B) are moved to the new
+      // ids, so the results do not depend on the order
+      if (order_by != NULL) {
+        vector<int> order;
+        ll time_order = current_timestamp();
+        if (!orderByName(G, order_by, order)) {
+          printf("Wrong order %s (only none, degree, rcm or slashburn)\n", order_by);
+          return 1;
+        }
+        if (!order.empty()) {
+          relabelCSR(G, order, newId);
+          unsigned char *l = new unsigned char[N + 1];
+          for (unsigned int r = 0; r < N; r++) l[r] = label[order[r]];
+          delete[] label;
+          label = l;
+        }
+        time_order = current_timestamp() - time_order;
+        if (verbose_flag) printf("Order %s [%llu]ms\n", order_by, time_order);
+      }
+
+      // Graph slices on the NUMA nodes of the threads processing them
+      if (numa_flag) numaPlaceCSR(G, threadNode, nodeOf);
+
+      color = new int[(size_t)colorings * N + 1];
+
       // if (verbose_flag) printf("|A| = %d | |B| = %d\n", Sa, Sb);
 
       for(unsigned int i=0; i<N; i++) sampleV.push_back(i);
 
       // Create DP Table
-      for (unsigned int i = 0; i <= q + 1; i++) M[i] = new map<COLORSET, ll>[N + 1];
+      dense_dp = q <= dense_q && q <= 16;
+      if (verbose_flag) printf("DP table: %s\n", dense_dp ? "dense" : "sparse");
+      if (dense_dp && load_dp == NULL) initDenseDP();
 
       // Random color graph
       if (verbose_flag) printf("Random coloring graph...\n");
@@ -677,17 +1527,39 @@ int main(int argc, char **argv) {
       // Fill dynamic programming table
       if (verbose_flag) printf("Processing DP table...\n");
       ll time_a = current_timestamp();
-      processDP();
+      if (load_dp != NULL) {
+        if (!loadDP(load_dp)) return 1;
+      } else
+        processDP();
       ll time_b = current_timestamp() - time_a;
       if (verbose_flag) printf("End processing DP table [%llu]ms\n", time_b);
 
+      if (save_dp != NULL) {
+        if (verbose_flag) printf("Saving DP table...\n");
+        if (!saveDP(save_dp)) return 1;
+      }
+
+      if (numa_flag && load_dp == NULL) {
+        NumaCounters traffic(topology.nodes());
+        for (unsigned int i = 2; i <= q; i++)
+          traffic.addLevel(G, nodeOf, [&](int u) {
+            size_t bytes = 0;
+            for (unsigned int c = 0; c < colorings; c++)
+              bytes += dense_dp ? binom[i - 1] * sizeof(ll)
+                                : M[i - 1][c].size(u) * (sizeof(COLORSET) + sizeof(ll));
+            return bytes;
+          });
+        traffic.print(time_b / 1000.0);
+      }
+
       ll time_dp = time_b;
 
       long long entry = 0;
+      for(unsigned int c=0; c<colorings; c++)
       for(int i=1; i<=q; i++)
       for(int j=0; j<N; j++)
       {
-        entry += M[i][j].size();
+        entry += sizeDP(c, i, j);
       }
       printf("DP ENTRY: [%lld]\n", entry);
       double bc_brute;
@@ -713,12 +1585,16 @@ int main(int argc, char **argv) {
       int tau_base;
       int tau_fsample;
 
+      size_t r_bc_fsample = 0, r_fj_fsample = 0;  // samples used with --epsilon
+      double ci_bc_fsample = 0, ci_fj_fsample = 0;
+
       ll time_brute = 0ll;
       ll time_fcount = 0ll;
       ll time_fsample = 0ll;
       ll time_base = 0ll;
 
       eng = mt19937_64(seed);
+      sampleStream = 0;
       srand(seed);
 
       set<int> A = randomChoose(Sa, mod);
@@ -738,6 +1614,52 @@ int main(int argc, char **argv) {
       for (int b : B) AB.insert(b);
       vector<int> ABv = vector<int>(AB.begin(), AB.end());
 
+      if (!newId.empty()) {
+        A = nodeIds(A);
+        B = nodeIds(B);
+        AB = nodeIds(AB);
+        for (int &u : X) u = nodeId(u);
+        for (int &u : ABv) u = nodeId(u);
+      }
+
+      SketchIndex index(0, sketch_size, bands);
+      if (index_flag) {
+        ll time_index = current_timestamp();
+        index = buildSketchIndex();
+        time_index = current_timestamp() - time_index;
+        printf("SKETCH INDEX: [%llu]ms\n", time_index);
+      }
+
+      // Nodes printed with the ids of the input graph
+      vector<int> oldId(N);
+      for (unsigned int u = 0; u < N; u++) oldId[u] = u;
+      for (size_t u = 0; u < newId.size(); u++) oldId[newId[u]] = u;
+
+      if (serve_flag) {
+        fflush(stdout);
+        uint64_t queries = 0;
+        return serveQueries(socket_path, [&](const string &line) {
+          return answerQuery(line, index, oldId, queries++);
+        }) ? 0 : 1;
+      }
+
+      if (index_flag) {
+        set<int> U;
+        if (query_nodes == NULL)
+          for (unsigned int u = 0; u < N; u++) U.insert(u);
+        else if (!parseNodes(query_nodes, U)) {
+          printf("Wrong query nodes %s\n", query_nodes);
+          return 1;
+        }
+        printf("NODE,RANK,SIMILAR,SIM\n");
+        for (int u : U) {
+          vector<pair<int, double>> best = index.top(nodeId(u), top);
+          for (size_t r = 0; r < best.size(); r++)
+            printf("%d,%zu,%d,%.6f\n", u, r + 1, oldId[best[r].first], best[r].second);
+        }
+        return 0;
+      }
+
       // HEADER
       printf("Q,R,HA,HB,");
       if( bruteforce_flag ) printf("BC_BRUTE,FJ_BRUTE,TAU,TIME,");
@@ -748,51 +1670,24 @@ int main(int argc, char **argv) {
       if( fsample_flag )
       printf("BC_FSAMPLE,BC_REL_FSAMPLE,FJ_FSAMPLE,FJ_REL_FSAMPLE,TAU_FSAMPLE,TIME_FSAMPLE,");
 
+      if( fsample_flag && epsilon > 0 )
+      printf("R_BC_FSAMPLE,CI_BC_FSAMPLE,R_FJ_FSAMPLE,CI_FJ_FSAMPLE,");
+
       if( baseline_flag )
       printf("BC_BASE,BC_REL_BASE,FJ_BASE,FJ_REL_BASE,TAU_BASE,TIME_BASE,");
 
 
       printf("\n");
 
-      map<string, ll> freqA, freqB, freqAB;
-      set<string> W;
-      double bcw, fjw;
-      long long Rp = 0ll;
-      long long Rpp = 0ll;
-
       double realBC = 1 , realFJ = 1;
       if( bruteforce_flag )
       {
         // BRUTE-FORCE
-        Rp = 0;
-        Rpp = 0;
-        W.clear();
-        freqA.clear();
-        freqB.clear();
-        dict.clear();
-        freqBrute.clear();
         time_brute = current_timestamp();
-        #pragma omp parallel for schedule(guided)
-        for (int i = 0; i < (int)ABv.size(); i++) {
-          int tid = omp_get_thread_num();
-          dfs(tid, ABv[i], q - 1);
-        }
-        for (auto w : freqBrute) {
-          int u = w.first.first;
-          string s = w.first.second;
-          ll freq = w.second;
-          Rp += freq;
-          if (A.find(u) != A.end()) {
-            freqA[s] += freq;
-          }
-          if (B.find(u) != B.end()) {
-            freqB[s] += freq;
-          }
-        }
+        bruteforceSimilarity(A, B, ABv, bc_brute, fj_brute, tau_brute);
         time_brute = current_timestamp() - time_brute;
-        tau_brute = dict.size();
-        bc_brute = realBC = bcw = BCW(dict, freqA, freqB);
-        fj_brute = realFJ = fjw = FJW(dict, freqA, freqB, (long long)Rp);
+        realBC = bc_brute;
+        realFJ = fj_brute;
       }
 
       // Experiments
@@ -803,130 +1698,52 @@ int main(int argc, char **argv) {
         // FCOUNT OK
         if( fcount_flag )
         {
-          // BRAY-CURTIS OK
-          Rp = 0;
-          W.clear();
-          freqA.clear();
-          freqB.clear();
           time_fcount = current_timestamp();
-          set<string> Sample = randomColorfulSample(X, R);
-          freqA = processFrequency(Sample, multiset<int>(A.begin(), A.end()));
-          freqB = processFrequency(Sample, multiset<int>(B.begin(), B.end()));
+          bc_fcount = fcountBC(A, B, X, tau_fcount);
           time_fcount = current_timestamp() - time_fcount;
-          tau_fcount = Sample.size();
-          bc_fcount = bcw = BCW(Sample, freqA, freqB);
-          if( bruteforce_flag )bc_fcount_rel = abs(bcw - realBC) / realBC;
-
-          // JACCARD OK
-          Rp = 0;
-          W.clear();
-          freqA.clear();
-          freqB.clear();
-          Sample = randomColorfulSample(vector<int>(AB.begin(), AB.end()), R);
-
-          for(int a : AB)
-          {
-            multiset<int> aa;
-            aa.insert(a);
-            freqAB = processFrequency(Sample, aa);
-            for (auto w : freqAB) {
-              Rp += w.second;
-              if (A.find(a) != A.end()) freqA[w.first] += w.second;
-              if (B.find(a) != B.end()) freqB[w.first] += w.second;
-            }
-          }
-          fj_fcount = fjw = FJW(Sample, freqA, freqB, Rp);
-          if( bruteforce_flag )fj_fcount_rel = abs(fjw - realFJ) / realFJ;
+          if( bruteforce_flag )bc_fcount_rel = abs(bc_fcount - realBC) / realBC;
+
+          fj_fcount = fcountFJ(A, B, ABv);
+          if( bruteforce_flag )fj_fcount_rel = abs(fj_fcount - realFJ) / realFJ;
         }
         /**************************************************************************/
         /**************************************************************************/
         // BASELINE
         if( baseline_flag )
         {
-          // BRAY-CURTIS
-          Rp = 0;
-          W.clear();
-          freqA.clear();
-          freqB.clear();
           time_base = current_timestamp();
-          map<pair<int, string>, ll> BLsampling = baselineSampler(X, R);
-          for (auto w : BLsampling) {
-            int u = w.first.first;
-            W.insert(w.first.second);
-            if (A.find(u) != A.end()) freqA[w.first.second] += w.second;
-            if (B.find(u) != B.end()) freqB[w.first.second] += w.second;
-          }
-          tau_base = W.size();
+          bc_base = sampleBC(A, B, baselineSampler(X, R), tau_base);
           time_base = current_timestamp() - time_base;
-          bc_base = bcw = BCW(W, freqA, freqB);
-          if( bruteforce_flag ) bc_base_rel = abs(bcw - realBC) / realBC;
-
-          // JACCARD
-          Rp = 0;
-          W.clear();
-          freqA.clear();
-          freqB.clear();
-          BLsampling = baselineSampler(ABv, R);
-          for (auto w : BLsampling) {
-            int u = w.first.first;
-            W.insert(w.first.second);
-            Rp += w.second;
-            if (A.find(u) != A.end()) freqA[w.first.second] += w.second;
-            if (B.find(u) != B.end()) freqB[w.first.second] += w.second;
-          }
-          fj_base = fjw = FJW(W, freqA, freqB, (long long)Rp); // ); OK
-          if( bruteforce_flag ) fj_base_rel = abs(fjw - realFJ) / realFJ;
+          if( bruteforce_flag ) bc_base_rel = abs(bc_base - realBC) / realBC;
+
+          fj_base = sampleFJ(A, B, baselineSampler(ABv, R));
+          if( bruteforce_flag ) fj_base_rel = abs(fj_base - realFJ) / realFJ;
         }
         /**************************************************************************/
         /**************************************************************************/
         // FSAMPLE
-        if( fsample_flag )
+        if( fsample_flag && epsilon > 0 )
         {
-          // BRAY-CURTIS
-          W.clear();
-          freqA.clear();
-          freqB.clear();
-          Rp = 0ll;
-
           time_fsample = current_timestamp();
-          map<pair<int, string>, ll> SamplePlus = randomColorfulSamplePlus(X, R);
-
-          for (auto w : SamplePlus) {
-            int u = w.first.first;
-            W.insert(w.first.second);
-            if (A.find(u) != A.end()) freqA[w.first.second] += w.second;
-            if (B.find(u) != B.end()) freqB[w.first.second] += w.second;
-          }
+          r_bc_fsample = adaptiveColorfulSample(X, A, B, true, bc_fsample,
+                                                ci_bc_fsample, tau_fsample);
+          time_fsample = current_timestamp() - time_fsample;
+          if( bruteforce_flag ) bc_fsample_rel = abs(bc_fsample - realBC) / realBC;
 
+          int tau_fj;
+          r_fj_fsample = adaptiveColorfulSample(ABv, A, B, false, fj_fsample,
+                                                ci_fj_fsample, tau_fj);
+          if( bruteforce_flag ) fj_fsample_rel = abs(fj_fsample - realFJ) / realFJ;
+        }
+        else if( fsample_flag )
+        {
+          time_fsample = current_timestamp();
+          bc_fsample = sampleBC(A, B, randomColorfulSamplePlus(X, R), tau_fsample);
           time_fsample = current_timestamp() - time_fsample;
-          tau_fsample = W.size();
-          bc_fsample = bcw = BCW(W, freqA, freqB);
-          if( bruteforce_flag ) bc_fsample_rel = abs(bcw - realBC) / realBC;
-
-          // JACCARD
-          W.clear();
-          freqA.clear();
-          freqB.clear();
-          Rp = 0ll;
-
-          SamplePlus = randomColorfulSamplePlus(ABv, R);
-
-          for (auto w : SamplePlus) {
-            int u = w.first.first;
-            W.insert(w.first.second);
-            Rp += w.second;
-            if (A.find(u) != A.end()) {
-              freqA[w.first.second] += w.second;
-//              Rp += w.second;
-            }
-            if (B.find(u) != B.end()) {
-              freqB[w.first.second] += w.second;
-              // Rp += w.second;
-            }
-          }
-          fj_fsample = fjw = FJW(W, freqA, freqB, (long long)Rp); // p);
-          if( bruteforce_flag ) fj_fsample_rel = abs(fjw - realFJ) / realFJ;
+          if( bruteforce_flag ) bc_fsample_rel = abs(bc_fsample - realBC) / realBC;
 
+          fj_fsample = sampleFJ(A, B, randomColorfulSamplePlus(ABv, R));
+          if( bruteforce_flag ) fj_fsample_rel = abs(fj_fsample - realFJ) / realFJ;
         }
         /**************************************************************************/
         /**************************************************************************/
@@ -961,6 +1778,13 @@ int main(int argc, char **argv) {
           printf("%4d,", tau_fsample);      // TAU
           printf("%4llu,", time_fsample);   // TIME
         }
+        if( fsample_flag && epsilon > 0 )
+        {
+          printf("%4zu,", r_bc_fsample);    // R-BC-fsample
+          printf("%.6f,", ci_bc_fsample);   // CI-BC-fsample
+          printf("%4zu,", r_fj_fsample);    // R-FJ-fsample
+          printf("%.6f,", ci_fj_fsample);   // CI-FJ-fsample
+        }
         if( baseline_flag )
         {
           printf("%.6f,", bc_base);      // BC-BASE
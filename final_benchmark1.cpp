@@ -20,6 +20,10 @@
 #include <unistd.h>
 #include <time.h>
 #include <sys/time.h>
+#include "graph_read.hpp"
+#include "frontier.hpp"
+#include "label_trie.hpp"
+#include "dp_store.hpp"
 
 #ifdef K_8
 #define MAXK 8
@@ -110,16 +114,11 @@ static int verbose_flag, help_flag;
 ll cont = 0;
 int *color;
 char *label;
-vector<int> *G;
+unsigned int labelBits = 1;  // bits per symbol in a QGram
+CSRGraph G;
 int Sa, Sb;
 int *A, *B;
 
-inline int nextInt() {
-  int r;
-  scanf("%d", &r);
-  return r;
-}
-
 // Random generator
 random_device rd;
 mt19937_64 eng = mt19937_64(rd());
@@ -143,9 +142,9 @@ inline void randomColor() {
 }
 
 // Path label
-string L(vector<int> P) {
-  string l = "";
-  for (size_t i = 0; i < P.size(); i++) l += label[P[i]];
+QGram L(const vector<int> &P) {
+  QGram l = 0;
+  for (size_t i = 0; i < P.size(); i++) l = qgramPush(l, label[P[i]] - 'A', labelBits);
   return l;
 }
 
@@ -179,31 +178,31 @@ void list_k_path(vector<int> ps, COLORSET cs, int x) {
 }
 
 // bruteforce
-set<string> dict;
-map<pair<int, string>, ll> freqBrute;
+QGramSet dict;
+StartQGramCount freqBrute;
 
 vector<int> P[30];
-string Pstring[30];
+QGram Pgram[30];
 set<int> Pset[30];
 
 void dfs(int t, int u, int k) {
   if (Pset[t].find(u) != Pset[t].end()) return;
 
   Pset[t].insert(u);
-  Pstring[t].push_back(label[u]);
+  Pgram[t] = qgramPush(Pgram[t], label[u] - 'A', labelBits);
   P[t].push_back(u);
 
   if (k == 0) {
 #pragma omp critical
     {
-      dict.insert(Pstring[t]);
-      freqBrute[make_pair(*P[t].begin(), Pstring[t])]++;
+      dict.insert(Pgram[t]);
+      freqBrute[make_pair(*P[t].begin(), Pgram[t])]++;
     }
   } else
     for (int v : G[u]) dfs(t, v, k - 1);
 
   Pset[t].erase(u);
-  Pstring[t].pop_back();
+  Pgram[t] = qgramPop(Pgram[t], labelBits);
   P[t].pop_back();
 }
 
@@ -233,50 +232,62 @@ void processDP() {
   }
 }
 
-bool isPrefix(set<string> W, string x) {
-  auto it = W.lower_bound(x);
-  if (it == W.end()) return false;
-  return mismatch(x.begin(), x.end(), (*it).begin()).first == x.end();
+// Save the DP table (and the coloring it was built with) to filename
+bool saveDP(const char *filename) {
+  DPHeader h = makeDPHeader(q, G, color, sizeof(int), sizeof(COLORSET), false);
+  DPFileWriter w(filename, h, color);
+  for (unsigned int i = 1; i <= q; i++) writeMapLayer(w, DP[i], N);
+  return w.close();
 }
 
-map<string, ll> processFrequency(set<string> W, multiset<int> X) {
-  set<string> WR;
-  for (string w : W) {
-    reverse(w.begin(), w.end());
-    WR.insert(w);
+// Load the DP table saved by saveDP for the same graph and q. The coloring
+// is random at every run, the one of the table is used.
+bool loadDP(const char *filename) {
+  DPFile f;
+  if (!f.open(filename)) return false;
+  if (f.h.n == N && f.h.colorBytes == sizeof(int))
+    memcpy(color, f.color, N * sizeof(int));
+  if (!f.matches(q, G, color, sizeof(int), sizeof(COLORSET))) {
+    printf("DP file %s was built for a different graph or q\n", filename);
+    return false;
   }
-  vector<tuple<int, string, COLORSET>> old;
+  for (unsigned int i = 1; i <= q; i++)
+    if (!readMapLayer(f, DP[i], N)) return false;
+  return true;
+}
 
-  for (int x : X)
-    if (isPrefix(WR, string(&label[x], 1)))
-      old.push_back(make_tuple(x, string(&label[x], 1), setBit(0ll, color[x])));
+// Colorful paths from X with label in W: the paths grow from X one node at
+// a time, every partial path carrying its state in the trie of the reversed
+// labels of W, and stop when no label of W ends with their label
+QGramCount processFrequency(const QGramSet &W, const multiset<int> &X) {
+  LabelTrie T(W, q, labelBits, true);
+  vector<tuple<int, uint32_t, COLORSET>> old;
+
+  for (int x : X) {
+    uint32_t s = T.step(T.root(), label[x] - 'A');
+    if (s != LabelTrie::NONE) old.push_back(make_tuple(x, s, setBit(0ll, color[x])));
+  }
 
   for (int i = q - 1; i > 0; i--) {
-    // printf("\t\ti = %d || |T| = %zu:\n", i, old.size());
-    vector<tuple<int, string, COLORSET>> current;
-#pragma omp parallel for schedule(dynamic)
-    for (int j = 0; j < (int)old.size(); j++) {
-      auto o = old[j];
-      int u = get<0>(o);
-      string LP = get<1>(o);
-      COLORSET CP = get<2>(o);
+    vector<tuple<int, uint32_t, COLORSET>> current;
+    expandFrontier(old.size(), current,
+                   [&](size_t j, vector<tuple<int, uint32_t, COLORSET>> &out) {
+      int u = get<0>(old[j]);
+      uint32_t s = get<1>(old[j]);
+      COLORSET CP = get<2>(old[j]);
       for (int v : G[u]) {
         if (getBit(CP, color[v])) continue;
-        COLORSET CPv = setBit(CP, color[v]);
-        string LPv = LP + label[v];
-        if (!isPrefix(WR, LPv)) continue;
-#pragma omp critical
-        { current.push_back(make_tuple(v, LPv, CPv)); }
+        uint32_t sv = T.step(s, label[v] - 'A');
+        if (sv == LabelTrie::NONE) continue;
+        out.push_back(make_tuple(v, sv, setBit(CP, color[v])));
       }
-    }
-    old = current;
-  }
-  map<string, ll> frequency;
-  for (auto c : old) {
-    string s = get<1>(c);
-    reverse(s.begin(), s.end());
-    frequency[s]++;
+    });
+    old.swap(current);
   }
+
+  QGramCount frequency;
+  for (auto &o : old)
+    if (T.word(get<1>(o)) >= 0) frequency[T.label(T.word(get<1>(o)))]++;
   return frequency;
 }
 
@@ -296,8 +307,8 @@ vector<int> randomPathTo(int u) {
   return P;
 }
 
-set<string> randomColorfulSample(vector<int> X, int r) {
-  set<string> W;
+QGramSet randomColorfulSample(vector<int> X, int r) {
+  QGramSet W;
   set<vector<int>> R;
   vector<ll> freqX;
   for (int x : X) freqX.push_back(DP[q][x][getCompl(0ll)]);
@@ -314,8 +325,8 @@ set<string> randomColorfulSample(vector<int> X, int r) {
   return W;
 }
 
-map<pair<int, string>, ll> randomColorfulSamplePlus(vector<int> X, int r) {
-  map<pair<int, string>, ll> W;
+StartQGramCount randomColorfulSamplePlus(vector<int> X, int r) {
+  StartQGramCount W;
   set<vector<int>> R;
   vector<ll> freqX;
   for (int x : X) freqX.push_back(DP[q][x][getCompl(0ll)]);
@@ -332,7 +343,7 @@ map<pair<int, string>, ll> randomColorfulSamplePlus(vector<int> X, int r) {
   return W;
 }
 
-set<string> BCSampler(set<int> A, set<int> B, int r) {
+QGramSet BCSampler(set<int> A, set<int> B, int r) {
   vector<int> X;
   for (int a : A) X.push_back(a);
   for (int b : B) X.push_back(b);
@@ -357,19 +368,19 @@ vector<int> naiveRandomPathTo(int u) {
   return P;
 }
 
-map<pair<int, string>, ll> baselineSampler(vector<int> X, int r) {
+StartQGramCount baselineSampler(vector<int> X, int r) {
   set<vector<int>> R;
   while (R.size() < (size_t)r) {
     int u = X[rand() % X.size()];
     vector<int> P = naiveRandomPathTo(u);
     if (P.size() == q && R.find(P) == R.end()) R.insert(P);
   }
-  map<pair<int, string>, ll> fx;
+  StartQGramCount fx;
   for (auto P : R) fx[make_pair(*P.begin(), L(P))]++;
   return fx;
 }
 
-double FJW(set<string> W, set<int> A, set<int> B) {
+double FJW(const QGramSet &W, const set<int> &A, const set<int> &B) {
   multiset<int> AiB, AB;
   for (int a : A) AB.insert(a);
   for (int b : B)
@@ -378,65 +389,65 @@ double FJW(set<string> W, set<int> A, set<int> B) {
     if (B.find(a) != B.end()) AiB.insert(a);
   long long num = 0ll;
   long long den = 0ll;
-  map<string, ll> freqAiB = processFrequency(W, AiB);
-  map<string, ll> freqAB = processFrequency(W, AB);
-  for (string w : W) {
-    num += freqAiB[w];
-    den += freqAB[w];
+  QGramCount freqAiB = processFrequency(W, AiB);
+  QGramCount freqAB = processFrequency(W, AB);
+  for (QGram w : W) {
+    num += qgramCount(freqAiB, w);
+    den += qgramCount(freqAB, w);
   }
   return (double)num / (double)den;
 }
 
-double BCW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
+double BCW(const QGramSet &W, const QGramCount &freqA, const QGramCount &freqB,
            long long R) {
   ll num = 0ll;
-  for (string x : W) {
-    ll fax = freqA[x];
-    ll fbx = freqB[x];
+  for (QGram x : W) {
+    ll fax = qgramCount(freqA, x);
+    ll fbx = qgramCount(freqB, x);
     num += 2 * min(fax, fbx);
   }
   return (double)num / (double)R;
 }
 
-double BCW(set<string> W, map<string, ll> freqA, map<string, ll> freqB) {
+double BCW(const QGramSet &W, const QGramCount &freqA, const QGramCount &freqB) {
   ll num = 0ll;
   ll den = 0ll;
-  for (string x : W) {
-    ll fax = freqA[x];
-    ll fbx = freqB[x];
+  for (QGram x : W) {
+    ll fax = qgramCount(freqA, x);
+    ll fbx = qgramCount(freqB, x);
     num += 2 * min(fax, fbx);
     den += fax + fbx;
   }
   return (double)num / (double)den;
 }
 
-double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
+double FJW(const QGramSet &W, const QGramCount &freqA, const QGramCount &freqB,
            long long R) {
   ll num = 0ll;
-  for (string x : W) {
-    ll fax = freqA[x];
-    ll fbx = freqB[x];
+  for (QGram x : W) {
+    ll fax = qgramCount(freqA, x);
+    ll fbx = qgramCount(freqB, x);
     num += min(fax, fbx);
   }
   //  printf("NUM = %lld DEN = %lld\n", num, R);
   return (double)num / (double)R;
 }
 
-double BCW(set<string> W, set<int> A, set<int> B) {
+double BCW(const QGramSet &W, const set<int> &A, const set<int> &B) {
   ll num = 0ll;
   ll den = 0ll;
   multiset<int> mA, mB;
   for (int a : A) mA.insert(a);
   for (int b : B) mB.insert(b);
-  map<string, ll> freqA = processFrequency(W, mA);
-  map<string, ll> freqB = processFrequency(W, mB);
-  vector<string> vW = vector<string>(W.begin(), W.end());
+  QGramCount freqA = processFrequency(W, mA);
+  QGramCount freqB = processFrequency(W, mB);
+  vector<QGram> vW(W.begin(), W.end());
   // #pragma omp parallel for schedule(static, 1) reduction(+:num), reduction(+:
   // den)
   for (int i = 0; i < (int)vW.size(); i++) {
-    string w = vW[i];
-    long long fax = freqA[w];
-    long long fbx = freqB[w];
+    QGram w = vW[i];
+    long long fax = qgramCount(freqA, w);
+    long long fbx = qgramCount(freqB, w);
     num += 2 * min(fax, fbx);
     den += fax + fbx;
   }
@@ -459,6 +470,12 @@ void print_usage(char *filename) {
   printf("-p, --parallel threadcount\n");
   printf("\tNumber of threads to use (default maximum thread avaiable)\n");
 
+  printf("--save-dp filename\n");
+  printf("\tSave the DP table to filename\n");
+
+  printf("--load-dp filename\n");
+  printf("\tLoad the DP table from filename instead of computing it\n");
+
   printf("--help\n");
   printf("\tDisplay help text and exit.\n");
 
@@ -468,6 +485,8 @@ void print_usage(char *filename) {
 
 bool input_graph_flag = false;
 char *input_graph = NULL;
+char *save_dp = NULL;
+char *load_dp = NULL;
 
 long long current_timestamp() {
   struct timeval te;
@@ -481,6 +500,8 @@ int main(int argc, char **argv) {
       {"path", required_argument, 0, 'q'},
       {"input", required_argument, 0, 'g'},
       {"parallel", required_argument, 0, 'p'},
+      {"save-dp", required_argument, 0, 's'},
+      {"load-dp", required_argument, 0, 'l'},
       {"help", no_argument, &help_flag, 1},
       {"verbose", no_argument, &verbose_flag, 1},
       {0, 0, 0, 0}};
@@ -503,6 +524,12 @@ int main(int argc, char **argv) {
       case 'p':
         if (optarg != NULL) thread_count = atoi(optarg);
         break;
+      case 's':
+        save_dp = optarg;
+        break;
+      case 'l':
+        load_dp = optarg;
+        break;
     }
   }
 
@@ -535,6 +562,7 @@ int main(int argc, char **argv) {
 
   if (verbose_flag) printf("Reading graph...\n");
 
+  vector<int> ab;
   if (input_graph_flag) {
     if (input_graph == NULL) {
       printf("Input file name missing!\n");
@@ -559,35 +587,28 @@ int main(int argc, char **argv) {
     for (unsigned int i = 0; i < N; i++) label[i] = 'A' + intLabel[i];
 
     if (verbose_flag) printf("Reading edges...\n");
-    G = new vector<int>[N + 1];
-    int *ab = new int[2 * M];
-    read(input_fd, ab, 2 * M * sizeof(int));
-    for (unsigned int i = 0; i < M; i++) {
-      G[ab[2 * i]].push_back(ab[2 * i + 1]);
-      G[ab[2 * i + 1]].push_back(ab[2 * i]);
-    }
-    free(ab);
+    ab.resize(2 * M);
+    read(input_fd, ab.data(), 2 * M * sizeof(int));
 
   } else {
     // Read from stdin, nme format
-    N = nextInt();
-    M = nextInt();
+    vector<int> in;
+    if (!readTextInts(NULL, in) || in.size() < 2 ||
+        in.size() < 2 + (size_t)in[0] + 2 * (size_t)in[1]) {
+      printf("Error reading input graph\n");
+      return 1;
+    }
+    N = in[0];
+    M = in[1];
     if (verbose_flag) printf("N = %d | M = %d\n", N, M);
 
     label = new char[N + 1];
     color = new int[N + 1];
-    G = new vector<int>[N + 1];
-
     if (verbose_flag) printf("Reading labels...\n");
-    for (unsigned int i = 0; i < N; i++) label[i] = 'A' + nextInt();
+    for (unsigned int i = 0; i < N; i++) label[i] = 'A' + in[2 + i];
 
     if (verbose_flag) printf("Reading edges...\n");
-    for (unsigned int i = 0; i < M; i++) {
-      int a = nextInt();
-      int b = nextInt();
-      G[a].push_back(b);
-      G[b].push_back(a);
-    }
+    ab.assign(in.begin() + 2 + N, in.begin() + 2 + N + 2 * M);
   }
 
   if (verbose_flag) printf("N = %d | M = %d\n", N, M);
@@ -598,15 +619,23 @@ int main(int argc, char **argv) {
   for (unsigned int i = 0; i <= q + 1; i++)
     DP[i] = new map<COLORSET, ll>[N + 1];
 
+  // Path labels packed in a QGram
+  labelBits = qgramBits(label, N, 'A');
+  if (q * labelBits > 8 * sizeof(QGram)) {
+    printf("Path labels of %u nodes do not fit in %zu bits\n", q, 8 * sizeof(QGram));
+    return 1;
+  }
+
   // Random color graph
   if (verbose_flag) printf("Random coloring graph...\n");
   randomColor();
 
   // Add fake node N connected to all the nodes
   for (unsigned int i = 0; i < N; i++) {
-    G[N].push_back(i);
-    G[i].push_back(N);
+    ab.push_back(N);
+    ab.push_back(i);
   }
+  buildCSR(G, N + 1, ab);
   color[N] = q;
   N++;
   q++;
@@ -614,15 +643,24 @@ int main(int argc, char **argv) {
   // Fill dynamic programming table
   if (verbose_flag) printf("Processing DP table...\n");
   ll time_a = current_timestamp();
-  processDP();
+  if (load_dp != NULL) {
+    if (!loadDP(load_dp)) return 1;
+  } else
+    processDP();
   ll time_b = current_timestamp() - time_a;
   if (verbose_flag) printf("End processing DP table [%llu]ms\n", time_b);
 
+  if (save_dp != NULL) {
+    if (verbose_flag) printf("Saving DP table...\n");
+    if (!saveDP(save_dp)) return 1;
+  }
+
   ll time_dp = time_b;
   // list_k_path(vector<int>(), setBit(0ll, color[N-1]), N-1);
   N--;
   q--;
-  for (unsigned int i = 0; i < N; i++) G[i].pop_back();
+  ab.resize(2 * M);
+  buildCSR(G, N, ab);
 
   vector<int> sampleV;
   for (unsigned int i = 0; i < N; i++) sampleV.push_back(i);
@@ -708,8 +746,8 @@ int main(int argc, char **argv) {
     for(int exp = 0 ; exp < 50 ; exp++)
     {
 
-    map<string, ll> freqA, freqB;
-    set<string> W;
+    QGramCount freqA, freqB;
+    QGramSet W;
     double bcw, fjw;
     long long Rp = 0ll;
 
@@ -731,7 +769,7 @@ int main(int argc, char **argv) {
     double realBC, realFJ;
     for (auto w : freqBrute) {
       int u = w.first.first;
-      string s = w.first.second;
+      QGram s = w.first.second;
       ll freq = w.second;
       if (A.find(u) != A.end()) {
         Rp += freq;
@@ -756,7 +794,7 @@ int main(int argc, char **argv) {
     freqB.clear();
     vmrss_base = getCurrentRSS();
     time_base = current_timestamp();
-    map<pair<int, string>, ll> BLsampling = baselineSampler(X, R);
+    StartQGramCount BLsampling = baselineSampler(X, R);
     for (auto w : BLsampling) {
       int u = w.first.first;
       W.insert(w.first.second);
@@ -780,7 +818,7 @@ int main(int argc, char **argv) {
     // printf("\t[ColorfulSampler]\n");
     time_alg3 = current_timestamp();
     vmrss_alg3 = getCurrentRSS();
-    set<string> Sample = randomColorfulSample(X, R);
+    QGramSet Sample = randomColorfulSample(X, R);
     freqA = processFrequency(Sample, multiset<int>(A.begin(), A.end()));
     freqB = processFrequency(Sample, multiset<int>(B.begin(), B.end()));
 
@@ -807,7 +845,7 @@ int main(int argc, char **argv) {
     time_2plus = current_timestamp();
     vmrss_2plus = getCurrentRSS();
 
-    map<pair<int, string>, ll> SamplePlus = randomColorfulSamplePlus(X, R);
+    StartQGramCount SamplePlus = randomColorfulSamplePlus(X, R);
     for (auto w : SamplePlus) W.insert(w.first.second);
 
     for (auto w : SamplePlus) {
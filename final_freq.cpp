@@ -22,6 +22,10 @@ using the color-coding technique (parallel version)
 #include <unistd.h>
 #include <time.h>
 #include <sys/time.h>
+#include "graph_read.hpp"
+#include "frontier.hpp"
+#include "label_trie.hpp"
+#include "dp_layer.hpp"
 
 #ifdef Q_8
 #define MAXQ 8
@@ -109,7 +113,8 @@ static int verbose_flag, help_flag, bruteforce_flag, fcount_flag, fsample_flag,
 ll cont = 0;
 int *color;
 char *label;
-vector<int> *G;
+unsigned int labelBits = 1;  // bits per symbol in a QGram
+CSRGraph G;
 int *A, *B;
 
 // parameter
@@ -125,12 +130,6 @@ unsigned int experiment = 10;
 long long fpaths = 0ll;
 long long fpathsc = 0ll;
 
-inline int nextInt() {
-  int r;
-  scanf("%d", &r);
-  return r;
-}
-
 // Random generator
 mt19937_64 eng;
 uniform_int_distribution<unsigned long long> distr;
@@ -153,9 +152,9 @@ inline void randomColor() {
 }
 
 // Path label
-string L(vector<int> P) {
-  string l = "";
-  for (size_t i = 0; i < P.size(); i++) l += label[P[i]];
+QGram L(const vector<int> &P) {
+  QGram l = 0;
+  for (size_t i = 0; i < P.size(); i++) l = qgramPush(l, label[P[i]] - 'A', labelBits);
   return l;
 }
 
@@ -172,11 +171,11 @@ bool colorful(vector<int> p)
 }
 
 // bruteforce
-set<string> dict;
-map<pair<int, string>, ll> freqBrute;
+QGramSet dict;
+StartQGramCount freqBrute;
 
 vector<int> P[80];
-string Pstring[80];
+QGram Pgram[80];
 set<int> Pset[80];
 //COLORSET Pcolor[80];
 
@@ -184,7 +183,7 @@ void dfs(int t, int u, int k) {
   if (Pset[t].find(u) != Pset[t].end()) return;
 
   Pset[t].insert(u);
-  Pstring[t].push_back(label[u]);
+  Pgram[t] = qgramPush(Pgram[t], label[u] - 'A', labelBits);
   P[t].push_back(u);
   //Pcolor[t] = setBit(Pcolor[t], color[u]);
 
@@ -195,90 +194,69 @@ void dfs(int t, int u, int k) {
       COLORSET cs = 0ll;
       for(int l : P[t] ) cs = setBit(cs, color[l]);
       if( cs == ( (1<<q)-1 ) ) fpathsc++;
-      dict.insert(Pstring[t]);
-      freqBrute[make_pair(*P[t].begin(), Pstring[t])]++;
+      dict.insert(Pgram[t]);
+      freqBrute[make_pair(*P[t].begin(), Pgram[t])]++;
     }
   } else {
     for (int v : G[u]) dfs(t, v, k - 1);
   }
   Pset[t].erase(u);
-  Pstring[t].pop_back();
+  Pgram[t] = qgramPop(Pgram[t], labelBits);
   P[t].pop_back();
   //Pcolor[t] = clearBit(Pcolor[t], color[u]);
 
 }
 
 // Dynamic Programming
-map<COLORSET, ll> *M[MAXQ + 1];
-int *MF[MAXQ + 1];
+DPLayer<COLORSET> M[MAXQ + 1];
+ll *MF[MAXQ + 1];
 
 void processDP() {
-  #pragma omp parallel for schedule(static)
-  for (unsigned int u = 0; u < N; u++) M[1][u][setBit(0, color[u])] = 1ll;
+  initLayer(M[1], N, color);
+  for (unsigned int i = 2; i <= q; i++) buildLayer(M[i], M[i - 1], N, G, color);
 
-  for (unsigned int i = 2; i <= q; i++) {
+  // Total number of colorful paths ending in every node
+  for (unsigned int i = 1; i <= q; i++) {
     #pragma omp parallel for schedule(static)
     for (unsigned int u = 0; u < N; u++) {
-      for (int v : G[u]) {
-        for (auto d : M[i - 1][v]) {
-          COLORSET s = d.first;
-          ll f = d.second;
-          if (getBit(s, color[u])) continue;
-          ll fp = M[i][u][setBit(s, color[u])];
-          M[i][u][setBit(s, color[u])] = f + fp;
-          MF[i][u] += f;
-        }
-      }
+      MF[i][u] = 0ll;
+      for (size_t j = M[i].off[u]; j < M[i].end[u]; j++) MF[i][u] += M[i].cnt[j];
     }
   }
 }
 
-bool isPrefix(set<string> W, string x) {
-  auto it = W.lower_bound(x);
-  if (it == W.end()) return false;
-  return mismatch(x.begin(), x.end(), (*it).begin()).first == x.end();
-}
+// Colorful paths from X with label in W: the paths grow from X one node at
+// a time, every partial path carrying its state in the trie of the reversed
+// labels of W, and stop when no label of W ends with their label
+QGramCount processFrequency(const QGramSet &W, const multiset<int> &X) {
+  LabelTrie T(W, q, labelBits, true);
+  vector<tuple<int, uint32_t, COLORSET>> old;
 
-map<string, ll> processFrequency(set<string> W, multiset<int> X) {
-  set<string> WR;
-  for (string w : W) {
-    reverse(w.begin(), w.end());
-    WR.insert(w);
+  for (int x : X) {
+    uint32_t s = T.step(T.root(), label[x] - 'A');
+    if (s != LabelTrie::NONE) old.push_back(make_tuple(x, s, setBit(0ll, color[x])));
   }
 
-  vector<tuple<int, string, COLORSET>> old;
-
-  for (int x : X)
-  if (isPrefix(WR, string(&label[x], 1)))
-  old.push_back(make_tuple(x, string(&label[x], 1), setBit(0ll, color[x])));
-
   for (int i = q - 1; i > 0; i--) {
-    vector<tuple<int, string, COLORSET>> current;
-    current.clear();
-    #pragma omp parallel for schedule(static)
-    for (int j = 0; j < (int)old.size(); j++) {
-      auto o = old[j];
-      int u = get<0>(o);
-      string LP = get<1>(o);
-      COLORSET CP = get<2>(o);
+    vector<tuple<int, uint32_t, COLORSET>> current;
+    expandFrontier(old.size(), current,
+                   [&](size_t j, vector<tuple<int, uint32_t, COLORSET>> &out) {
+      int u = get<0>(old[j]);
+      uint32_t s = get<1>(old[j]);
+      COLORSET CP = get<2>(old[j]);
       for (int v : G[u]) {
         if (getBit(CP, color[v])) continue;
-        COLORSET CPv = setBit(CP, color[v]);
-        string LPv = LP + label[v];
-        if (!isPrefix(WR, LPv)) continue;
-        #pragma omp critical
-        { current.push_back(make_tuple(v, LPv, CPv)); }
+        uint32_t sv = T.step(s, label[v] - 'A');
+        if (sv == LabelTrie::NONE) continue;
+        out.push_back(make_tuple(v, sv, setBit(CP, color[v])));
       }
-    }
-    old = current;
+    });
+    old.swap(current);
   }
 
-  map<string, ll> frequency;
-  for (auto c : old) {
-    string s = get<1>(c);
-    reverse(s.begin(), s.end());
-    frequency[s]++;
-  }
+  QGramCount frequency;
+  for (auto &o : old)
+    if (T.word(get<1>(o)) >= 0) frequency[T.label(T.word(get<1>(o)))]++;
   return frequency;
 }
 
@@ -288,7 +266,7 @@ vector<int> randomPathTo(int u) {
   COLORSET D = getCompl(setBit(0l, color[u]));
   for (int i = q - 1; i > 0; i--) {
     vector<ll> freq;
-    for (int v : G[u]) freq.push_back(M[i][v][D]);
+    for (int v : G[u]) freq.push_back(M[i].get(v, D));
     discrete_distribution<int> distribution(freq.begin(), freq.end());
     #pragma omp critical
     {
@@ -303,11 +281,11 @@ vector<int> randomPathTo(int u) {
   return ret;
 }
 
-set<string> randomColorfulSample(vector<int> X, int r) {
-  set<string> W;
+QGramSet randomColorfulSample(vector<int> X, int r) {
+  QGramSet W;
   set<vector<int>> R;
   vector<ll> freqX;
-  for (int x : X) freqX.push_back(M[q][x][getCompl(0ll)]);
+  for (int x : X) freqX.push_back(M[q].get(x, getCompl(0ll)));
   discrete_distribution<int> distribution(freqX.begin(), freqX.end());
   while (R.size() < (size_t)r) {
     int u = X[distribution(eng)];
@@ -321,12 +299,12 @@ set<string> randomColorfulSample(vector<int> X, int r) {
   return W;
 }
 
-map<pair<int, string>, ll> randomColorfulSamplePlus(vector<int> X, int r) {
-  map<pair<int, string>, ll> W;
+StartQGramCount randomColorfulSamplePlus(vector<int> X, int r) {
+  StartQGramCount W;
   set<vector<int>> R;
   vector<ll> freqX;
   freqX.clear();
-  for (int x : X) freqX.push_back(M[q][x][getCompl(0ll)]);
+  for (int x : X) freqX.push_back(M[q].get(x, getCompl(0ll)));
   discrete_distribution<int> distribution(freqX.begin(), freqX.end());
   while( R.size() < (size_t)r)
   {
@@ -353,7 +331,7 @@ map<pair<int, string>, ll> randomColorfulSamplePlus(vector<int> X, int r) {
   return W;
 }
 
-set<string> BCSampler(set<int> A, set<int> B, int r) {
+QGramSet BCSampler(set<int> A, set<int> B, int r) {
   vector<int> X;
   for (int a : A) X.push_back(a);
   for (int b : B) X.push_back(b);
@@ -387,8 +365,8 @@ vector<int> naiveRandomPathTo(int u) {
   }
   return P;
 }
-map<pair<int, string>, ll> baselineSampler(vector<int> X, int r) {
-//set<string> baselineSampler(vector<int> X, int r) {
+StartQGramCount baselineSampler(vector<int> X, int r) {
+//QGramSet baselineSampler(vector<int> X, int r) {
   set<vector<int>> R;
   long long ps = 0ll;
   long long cs = 0ll;
@@ -419,11 +397,11 @@ map<pair<int, string>, ll> baselineSampler(vector<int> X, int r) {
     }
   }
   ps = R.size();
-  map<string, ll> freqP;
-  map<string, ll> freqC;
+  QGramCount freqP;
+  QGramCount freqC;
   for(auto P : R)
   {
-    string label = L(P);
+    QGram label = L(P);
     freqP[ label ]++;
     COLORSET s = 0ll;
     for(int l : P ) s = setBit(s, color[l]);
@@ -439,7 +417,7 @@ map<pair<int, string>, ll> baselineSampler(vector<int> X, int r) {
   //   closest.push_back( make_pair( dist, s) );
   // }
   // sort(closest.begin(), closest.end());
-  // set<string> ret;
+  // QGramSet ret;
   // for(int i=0; i<5; i++)
   // {
   //   string s = closest[i].second;
@@ -454,30 +432,30 @@ map<pair<int, string>, ll> baselineSampler(vector<int> X, int r) {
 //    printf("\t[%4s] [%5lld][%5lld] [%.6f]\n", s.c_str(), freqP[s], freqC[s], (double)freqC[s]/freqP[s] );
 //  }
 //  printf("PATHS = %lld || C-PATHS = %lld\n", ps, cs);
-  map<pair<int, string>, ll> fx;
+  StartQGramCount fx;
   for (auto P : R) fx[make_pair(*P.begin(), L(P))]++;
   return fx;
 }
 
 
-double BCW(set<string> W, map<string, ll> freqA, map<string, ll> freqB) {
+double BCW(const QGramSet &W, const QGramCount &freqA, const QGramCount &freqB) {
   ll num = 0ll;
   ll den = 0ll;
-  for (string x : W) {
-    ll fax = freqA[x];
-    ll fbx = freqB[x];
+  for (QGram x : W) {
+    ll fax = qgramCount(freqA, x);
+    ll fbx = qgramCount(freqB, x);
     num += 2 * min(fax, fbx);
     den += fax + fbx;
   }
   return (double)num / (double)den;
 }
 
-double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
+double FJW(const QGramSet &W, const QGramCount &freqA, const QGramCount &freqB,
   long long R) {
     ll num = 0ll;
-    for (string x : W) {
-      ll fax = freqA[x];
-      ll fbx = freqB[x];
+    for (QGram x : W) {
+      ll fax = qgramCount(freqA, x);
+      ll fbx = qgramCount(freqB, x);
       num += min(fax, fbx);
     }
     return (double)num / (double) R;
@@ -525,7 +503,7 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
       printf("Valid arguments:\n");
 
       printf("-g, --input filename\n");
-      printf("\tInput file of labeled graph in nmle format (default stdin)\n");
+      printf("\tInput file of labeled graph in nme.bin or csr format (default stdin)\n");
 
       printf("-p, --parallel threadcount\n");
       printf("\tNumber of threads to use (default maximum thread avaiable)\n");
@@ -698,7 +676,20 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
       ratio = (double) num / den;
       if (verbose_flag) printf("Reading graph...\n");
 
-      if (input_graph_flag) {
+      if (input_graph_flag && input_graph != NULL && isCSRFile(input_graph)) {
+        // CSR graph file, mapped and used in place
+        const int *intLabel = NULL;
+        if (!mapCSR(input_graph, G, &intLabel, NULL)) return 1;
+        N = G.n;
+        E = G.arcs() / 2;
+        if (verbose_flag) printf("N = %d | E = %d\n", N, E);
+
+        label = new char[N + 1];
+        color = new int[N + 1];
+        for (unsigned int i = 0; i < N; i++)
+          label[i] = 'A' + (intLabel != NULL ? intLabel[i] : 0);
+
+      } else if (input_graph_flag) {
         if (input_graph == NULL) {
           printf("Input file name missing!\n");
           return 1;
@@ -722,35 +713,30 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
         for (unsigned int i = 0; i < N; i++) label[i] = 'A' + intLabel[i];
 
         if (verbose_flag) printf("Reading edges...\n");
-        G = new vector<int>[N + 1];
         int *ab = new int[2 * E];
         read(input_fd, ab, 2 * E * sizeof(int));
-        for (unsigned int i = 0; i < E; i++) {
-          G[ab[2 * i]].push_back(ab[2 * i + 1]);
-          G[ab[2 * i + 1]].push_back(ab[2 * i]);
-        }
-        free(ab);
+        buildCSR(G, N, ab, E);
+        delete[] ab;
 
       } else {
         // Read from stdin, nme format
-        N = nextInt();
-        E = nextInt();
+        vector<int> in;
+        if (!readTextInts(NULL, in) || in.size() < 2 ||
+            in.size() < 2 + (size_t)in[0] + 2 * (size_t)in[1]) {
+          printf("Error reading input graph\n");
+          return 1;
+        }
+        N = in[0];
+        E = in[1];
         if (verbose_flag) printf("N = %d | E = %d\n", N, E);
 
         label = new char[N + 1];
         color = new int[N + 1];
-        G = new vector<int>[N + 1];
-
         if (verbose_flag) printf("Reading labels...\n");
-        for (unsigned int i = 0; i < N; i++) label[i] = 'A' + nextInt();
+        for (unsigned int i = 0; i < N; i++) label[i] = 'A' + in[2 + i];
 
         if (verbose_flag) printf("Reading edges...\n");
-        for (unsigned int i = 0; i < E; i++) {
-          int a = nextInt();
-          int b = nextInt();
-          G[a].push_back(b);
-          G[b].push_back(a);
-        }
+        buildCSR(G, N, in.data() + 2 + N, E);
       }
 
       if (verbose_flag) printf("N = %d | E = %d\n", N, E);
@@ -760,10 +746,13 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
       for(unsigned int i=0; i<N; i++) sampleV.push_back(i);
 
       // Create DP Table
-      for (unsigned int i = 0; i <= q + 1; i++)
-      {
-        MF[i] = new int[N];
-        M[i] = new map<COLORSET, ll>[N + 1];
+      for (unsigned int i = 0; i <= q + 1; i++) MF[i] = new ll[N];
+
+      // Path labels packed in a QGram
+      labelBits = qgramBits(label, N, 'A');
+      if (q * labelBits > 8 * sizeof(QGram)) {
+        printf("Path labels of %u nodes do not fit in %zu bits\n", q, 8 * sizeof(QGram));
+        return 1;
       }
 
       // Random color graph
@@ -837,8 +826,8 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
 
       printf("\n");
 
-      map<string, ll> freqA, freqB, freqAB;
-      set<string> W;
+      QGramCount freqA, freqB, freqAB;
+      QGramSet W;
       double bcw, fjw;
       long long Rp = 0ll;
       long long Rpp = 0ll;
@@ -862,7 +851,7 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
         }
         for (auto w : freqBrute) {
           int u = w.first.first;
-          string s = w.first.second;
+          QGram s = w.first.second;
           ll freq = w.second;
           Rp += freq;
           if (A.find(u) != A.end()) {
@@ -894,7 +883,7 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
           freqA.clear();
           freqB.clear();
           time_fcount = current_timestamp();
-          set<string> Sample = randomColorfulSample(X, R);
+          QGramSet Sample = randomColorfulSample(X, R);
           freqA = processFrequency(Sample, multiset<int>(A.begin(), A.end()));
           freqB = processFrequency(Sample, multiset<int>(B.begin(), B.end()));
           time_fcount = current_timestamp() - time_fcount;
@@ -934,10 +923,10 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
           freqA.clear();
           freqB.clear();
           time_base = current_timestamp();
-          // set<string> BLsampling = baselineSampler(X, R);
+          // QGramSet BLsampling = baselineSampler(X, R);
           // map<string,  BLsampling = baselineSampler(X, R);
 
-          map<pair<int, string>, ll> BLsampling = baselineSampler(X, R);
+          StartQGramCount BLsampling = baselineSampler(X, R);
           // freqA = processFrequency(BLsampling, multiset<int>(A.begin(), A.end()));
           // freqB = processFrequency(BLsampling, multiset<int>(B.begin(), B.end()));
 
@@ -980,7 +969,7 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB,
           Rp = 0ll;
 
           time_fsample = current_timestamp();
-          map<pair<int, string>, ll> SamplePlus = randomColorfulSamplePlus(X, R);
+          StartQGramCount SamplePlus = randomColorfulSamplePlus(X, R);
 
           for (auto w : SamplePlus) {
             int u = w.first.first;
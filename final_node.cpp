@@ -22,6 +22,11 @@ using the color-coding technique (parallel version)
 #include <unistd.h>
 #include <time.h>
 #include <sys/time.h>
+#include "graph_read.hpp"
+#include "frontier.hpp"
+#include "label_trie.hpp"
+#include "dp_layer.hpp"
+#include "path_sampler.hpp"
 
 #ifdef Q_8
 #define MAXQ 8
@@ -109,7 +114,8 @@ static int verbose_flag, help_flag, bruteforce_flag, fcount_flag, fsample_flag,
 ll cont = 0;
 int *color;
 char *label;
-vector<int> *G;
+unsigned int labelBits = 1;  // bits per symbol in a QGram
+CSRGraph G;
 int *A, *B;
 
 // parameter
@@ -121,12 +127,6 @@ unsigned int Sa = 10, Sb = 10;
 unsigned int mod = 0;
 unsigned int experiment = 10;
 
-inline int nextInt() {
-  int r;
-  scanf("%d", &r);
-  return r;
-}
-
 // Random generator
 mt19937_64 eng;
 uniform_int_distribution<unsigned long long> distr;
@@ -149,124 +149,97 @@ inline void randomColor() {
 }
 
 // Path label
-string L(vector<int> P) {
-  string l = "";
-  for (size_t i = 0; i < P.size(); i++) l += label[P[i]];
+QGram L(const vector<int> &P) {
+  QGram l = 0;
+  for (size_t i = 0; i < P.size(); i++) l = qgramPush(l, label[P[i]] - 'A', labelBits);
   return l;
 }
 
 // bruteforce
-set<string> dict;
-map<pair<int, string>, ll> freqBrute;
+QGramSet dict;
+StartQGramCount freqBrute;
 
 vector<int> P[30];
-string Pstring[30];
+QGram Pgram[30];
 set<int> Pset[30];
 
 void dfs(int t, int u, int k) {
   if (Pset[t].find(u) != Pset[t].end()) return;
 
   Pset[t].insert(u);
-  Pstring[t].push_back(label[u]);
+  Pgram[t] = qgramPush(Pgram[t], label[u] - 'A', labelBits);
   P[t].push_back(u);
 
   if (k == 0) {
     #pragma omp critical
     {
-      dict.insert(Pstring[t]);
-      freqBrute[make_pair(*P[t].begin(), Pstring[t])]++;
+      dict.insert(Pgram[t]);
+      freqBrute[make_pair(*P[t].begin(), Pgram[t])]++;
     }
   } else {
     for (int v : G[u]) dfs(t, v, k - 1);
   }
   Pset[t].erase(u);
-  Pstring[t].pop_back();
+  Pgram[t] = qgramPop(Pgram[t], labelBits);
   P[t].pop_back();
 }
 
 // Dynamic Programming
-map<COLORSET, ll> *M[MAXQ + 1];
+DPLayer<COLORSET> M[MAXQ + 1];
 
 void processDP() {
-  #pragma omp parallel for schedule(guided)
-  for (unsigned int u = 0; u < N; u++) M[1][u][setBit(0, color[u])] = 1ll;
-
-  for (unsigned int i = 2; i <= q; i++) {
-    #pragma omp parallel for schedule(guided)
-    for (unsigned int u = 0; u < N; u++) {
-      for (int v : G[u]) {
-        for (auto d : M[i - 1][v]) {
-          COLORSET s = d.first;
-          ll f = d.second;
-          if (getBit(s, color[u])) continue;
-          ll fp = M[i][u][setBit(s, color[u])];
-          M[i][u][setBit(s, color[u])] = f + fp;
-        }
-      }
-    }
-  }
+  initLayer(M[1], N, color);
+  for (unsigned int i = 2; i <= q; i++) buildLayer(M[i], M[i - 1], N, G, color);
 }
 
-bool isPrefix(set<string> W, string x) {
-  auto it = W.lower_bound(x);
-  if (it == W.end()) return false;
-  return mismatch(x.begin(), x.end(), (*it).begin()).first == x.end();
-}
+// Colorful paths from X with label in W: the paths grow from X one node at
+// a time, every partial path carrying its state in the trie of the reversed
+// labels of W, and stop when no label of W ends with their label
+QGramCount processFrequency(const QGramSet &W, const multiset<int> &X) {
+  LabelTrie T(W, q, labelBits, true);
+  vector<tuple<int, uint32_t, COLORSET>> old;
 
-map<string, ll> processFrequency(set<string> W, multiset<int> X) {
-  set<string> WR;
-  for (string w : W) {
-    reverse(w.begin(), w.end());
-    WR.insert(w);
+  for (int x : X) {
+    uint32_t s = T.step(T.root(), label[x] - 'A');
+    if (s != LabelTrie::NONE) old.push_back(make_tuple(x, s, setBit(0ll, color[x])));
   }
 
-  vector<tuple<int, string, COLORSET>> old;
-
-  for (int x : X)
-  if (isPrefix(WR, string(&label[x], 1)))
-  old.push_back(make_tuple(x, string(&label[x], 1), setBit(0ll, color[x])));
-
   for (int i = q - 1; i > 0; i--) {
-    vector<tuple<int, string, COLORSET>> current;
-    current.clear();
-    #pragma omp parallel for schedule(guided)
-    for (int j = 0; j < (int)old.size(); j++) {
-      auto o = old[j];
-      int u = get<0>(o);
-      string LP = get<1>(o);
-      COLORSET CP = get<2>(o);
+    vector<tuple<int, uint32_t, COLORSET>> current;
+    expandFrontier(old.size(), current,
+                   [&](size_t j, vector<tuple<int, uint32_t, COLORSET>> &out) {
+      int u = get<0>(old[j]);
+      uint32_t s = get<1>(old[j]);
+      COLORSET CP = get<2>(old[j]);
       for (int v : G[u]) {
         if (getBit(CP, color[v])) continue;
-        COLORSET CPv = setBit(CP, color[v]);
-        string LPv = LP + label[v];
-        if (!isPrefix(WR, LPv)) continue;
-        #pragma omp critical
-        { current.push_back(make_tuple(v, LPv, CPv)); }
+        uint32_t sv = T.step(s, label[v] - 'A');
+        if (sv == LabelTrie::NONE) continue;
+        out.push_back(make_tuple(v, sv, setBit(CP, color[v])));
       }
-    }
-    old = current;
+    });
+    old.swap(current);
   }
 
-  map<string, ll> frequency;
-  for (auto c : old) {
-    string s = get<1>(c);
-    reverse(s.begin(), s.end());
-    frequency[s]++;
-  }
+  QGramCount frequency;
+  for (auto &o : old)
+    if (T.word(get<1>(o)) >= 0) frequency[T.label(T.word(get<1>(o)))]++;
   return frequency;
 }
 
+// Steps of randomPathTo, cached across the samples (the DP does not change)
+PathSampler sampler;
+
 vector<int> randomPathTo(int u) {
   list<int> P;
   P.push_front(u);
   COLORSET D = getCompl(setBit(0l, color[u]));
   for (int i = q - 1; i > 0; i--) {
-    vector<ll> freq;
-    for (int v : G[u]) freq.push_back(M[i][v][D]);
-    discrete_distribution<int> distribution(freq.begin(), freq.end());
+    const PathStep &S =
+        sampler.step(G, i, u, D, [&](int v) { return M[i].get(v, D); });
     #pragma omp critical
     {
-      u = G[u][distribution(eng)];
+      u = S.sample(eng);
     }
     P.push_front(u);
     D = clearBit(D, color[u]);
@@ -277,11 +250,11 @@ vector<int> randomPathTo(int u) {
   return ret;
 }
 
-set<string> randomColorfulSample(vector<int> X, int r) {
-  set<string> W;
+QGramSet randomColorfulSample(vector<int> X, int r) {
+  QGramSet W;
   set<vector<int>> R;
   vector<ll> freqX;
-  for (int x : X) freqX.push_back(M[q][x][getCompl(0ll)]);
+  for (int x : X) freqX.push_back(M[q].get(x, getCompl(0ll)));
   discrete_distribution<int> distribution(freqX.begin(), freqX.end());
   while (R.size() < (size_t)r) {
     int u = X[distribution(eng)];
@@ -295,12 +268,12 @@ set<string> randomColorfulSample(vector<int> X, int r) {
   return W;
 }
 
-map<pair<int, string>, ll> randomColorfulSamplePlus(vector<int> X, int r) {
-  map<pair<int, string>, ll> W;
+StartQGramCount randomColorfulSamplePlus(vector<int> X, int r) {
+  StartQGramCount W;
   set<vector<int>> R;
   vector<ll> freqX;
   freqX.clear();
-  for (int x : X) freqX.push_back(M[q][x][getCompl(0ll)]);
+  for (int x : X) freqX.push_back(M[q].get(x, getCompl(0ll)));
   discrete_distribution<int> distribution(freqX.begin(), freqX.end());
   while( R.size() < (size_t)r)
   {
@@ -327,7 +300,7 @@ map<pair<int, string>, ll> randomColorfulSamplePlus(vector<int> X, int r) {
   return W;
 }
 
-set<string> BCSampler(set<int> A, set<int> B, int r) {
+QGramSet BCSampler(set<int> A, set<int> B, int r) {
   vector<int> X;
   for (int a : A) X.push_back(a);
   for (int b : B) X.push_back(b);
@@ -355,7 +328,7 @@ vector<int> naiveRandomPathTo(int u) {
   return P;
 }
 
-map<pair<int, string>, ll> baselineSampler(vector<int> X, int r) {
+StartQGramCount baselineSampler(vector<int> X, int r) {
   set<vector<int>> R;
 
   while( R.size() < (size_t)r)
@@ -376,40 +349,43 @@ map<pair<int, string>, ll> baselineSampler(vector<int> X, int r) {
       }
     }
   }
-  map<pair<int, string>, ll> fx;
-  for (auto P : R) fx[make_pair(*P.begin(), L(P))]++;
+  StartQGramCount fx;
+  // the walks stuck before q nodes are not q-paths (and their packed
+  // labels would equal those of longer labels)
+  for (auto P : R)
+    if (P.size() == q) fx[make_pair(*P.begin(), L(P))]++;
   return fx;
 }
 
-double BCW(set<string> W, map<string, ll> freqA, map<string, ll> freqB) {
+double BCW(const QGramSet &W, const QGramCount &freqA, const QGramCount &freqB) {
   double ret = 0.;
 
-  for (string x : W) {
-    ll fax = freqA[x];
-    ll fbx = freqB[x];
+  for (QGram x : W) {
+    ll fax = qgramCount(freqA, x);
+    ll fbx = qgramCount(freqB, x);
     if( fax + fbx == 0 ) continue;
     ret += (double) min(fax, fbx) / ( fax + fbx );
   }
   return ((double) 2 / W.size()) * ret;
 }
 
-double BCW_old(set<string> W, map<string, ll> freqA, map<string, ll> freqB) {
+double BCW_old(const QGramSet &W, const QGramCount &freqA, const QGramCount &freqB) {
   ll num = 0ll;
   ll den = 0ll;
-  for (string x : W) {
-    ll fax = freqA[x];
-    ll fbx = freqB[x];
+  for (QGram x : W) {
+    ll fax = qgramCount(freqA, x);
+    ll fbx = qgramCount(freqB, x);
     num += 2 * min(fax, fbx);
     den += fax + fbx;
   }
   return (double)num / (double)den;
 }
 
-double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB, long long R) {
+double FJW(const QGramSet &W, const QGramCount &freqA, const QGramCount &freqB, long long R) {
   ll num = 0ll;
-  for (string x : W) {
-    ll fax = freqA[x];
-    ll fbx = freqB[x];
+  for (QGram x : W) {
+    ll fax = qgramCount(freqA, x);
+    ll fbx = qgramCount(freqB, x);
     num += min(fax, fbx);
   }
   return (double)num / (double) R;
@@ -457,7 +433,7 @@ double FJW(set<string> W, map<string, ll> freqA, map<string, ll> freqB, long lon
       printf("Valid arguments:\n");
 
       printf("-g, --input filename\n");
-      printf("\tInput file of labeled graph in nmle format (default stdin)\n");
+      printf("\tInput file of labeled graph in nme.bin or csr format (default stdin)\n");
 
       printf("-p, --parallel threadcount\n");
       printf("\tNumber of threads to use (default maximum thread avaiable)\n");
@@ -617,7 +593,20 @@ int main(int argc, char **argv) {
 
       if (verbose_flag) printf("Reading graph...\n");
 
-      if (input_graph_flag) {
+      if (input_graph_flag && input_graph != NULL && isCSRFile(input_graph)) {
+        // CSR graph file, mapped and used in place
+        const int *intLabel = NULL;
+        if (!mapCSR(input_graph, G, &intLabel, NULL)) return 1;
+        N = G.n;
+        E = G.arcs() / 2;
+        if (verbose_flag) printf("N = %d | E = %d\n", N, E);
+
+        label = new char[N + 1];
+        color = new int[N + 1];
+        for (unsigned int i = 0; i < N; i++)
+          label[i] = 'A' + (intLabel != NULL ? intLabel[i] : 0);
+
+      } else if (input_graph_flag) {
         if (input_graph == NULL) {
           printf("Input file name missing!\n");
           return 1;
@@ -641,35 +630,30 @@ int main(int argc, char **argv) {
         for (unsigned int i = 0; i < N; i++) label[i] = 'A' + intLabel[i];
 
         if (verbose_flag) printf("Reading edges...\n");
-        G = new vector<int>[N + 1];
         int *ab = new int[2 * E];
         read(input_fd, ab, 2 * E * sizeof(int));
-        for (unsigned int i = 0; i < E; i++) {
-          G[ab[2 * i]].push_back(ab[2 * i + 1]);
-          G[ab[2 * i + 1]].push_back(ab[2 * i]);
-        }
-        free(ab);
+        buildCSR(G, N, ab, E);
+        delete[] ab;
 
       } else {
         // Read from stdin, nme format
-        N = nextInt();
-        E = nextInt();
+        vector<int> in;
+        if (!readTextInts(NULL, in) || in.size() < 2 ||
+            in.size() < 2 + (size_t)in[0] + 2 * (size_t)in[1]) {
+          printf("Error reading input graph\n");
+          return 1;
+        }
+        N = in[0];
+        E = in[1];
         if (verbose_flag) printf("N = %d | E = %d\n", N, E);
 
         label = new char[N + 1];
         color = new int[N + 1];
-        G = new vector<int>[N + 1];
-
         if (verbose_flag) printf("Reading labels...\n");
-        for (unsigned int i = 0; i < N; i++) label[i] = 'A' + nextInt();
+        for (unsigned int i = 0; i < N; i++) label[i] = 'A' + in[2 + i];
 
         if (verbose_flag) printf("Reading edges...\n");
-        for (unsigned int i = 0; i < E; i++) {
-          int a = nextInt();
-          int b = nextInt();
-          G[a].push_back(b);
-          G[b].push_back(a);
-        }
+        buildCSR(G, N, in.data() + 2 + N, E);
       }
 
       if (verbose_flag) printf("N = %d | E = %d\n", N, E);
@@ -678,8 +662,12 @@ int main(int argc, char **argv) {
 
       for(unsigned int i=0; i<N; i++) sampleV.push_back(i);
 
-      // Create DP Table
-      for (unsigned int i = 0; i <= q + 1; i++) M[i] = new map<COLORSET, ll>[N + 1];
+      // Path labels packed in a QGram
+      labelBits = qgramBits(label, N, 'A');
+      if (q * labelBits > 8 * sizeof(QGram)) {
+        printf("Path labels of %u nodes do not fit in %zu bits\n", q, 8 * sizeof(QGram));
+        return 1;
+      }
 
       // Random color graph
       if (verbose_flag) printf("Random coloring graph...\n");
@@ -698,7 +686,7 @@ int main(int argc, char **argv) {
       for(int i=1; i<=q; i++)
       for(int j=0; j<N; j++)
       {
-        entry += M[i][j].size();
+        entry += M[i].size(j);
       }
       printf("DP ENTRY: [%lld]\n", entry);
       double bc_brute;
@@ -777,8 +765,8 @@ int main(int argc, char **argv) {
 
       printf("\n");
 
-      map<string, ll> freqA, freqB, freqAB;
-      set<string> W;
+      QGramCount freqA, freqB, freqAB;
+      QGramSet W;
       double bcw, fjw;
       long long Rp = 0ll;
       long long Rpp = 0ll;
@@ -802,7 +790,7 @@ int main(int argc, char **argv) {
         }
         for (auto w : freqBrute) {
           int u = w.first.first;
-          string s = w.first.second;
+          QGram s = w.first.second;
           ll freq = w.second;
           Rp += freq;
           if (A.find(u) != A.end()) {
@@ -832,7 +820,7 @@ int main(int argc, char **argv) {
           freqA.clear();
           freqB.clear();
           time_fcount = current_timestamp();
-          set<string> Sample = randomColorfulSample(X, R);
+          QGramSet Sample = randomColorfulSample(X, R);
           freqA = processFrequency(Sample, multiset<int>(A.begin(), A.end()));
           freqB = processFrequency(Sample, multiset<int>(B.begin(), B.end()));
           time_fcount = current_timestamp() - time_fcount;
@@ -872,7 +860,7 @@ int main(int argc, char **argv) {
           freqA.clear();
           freqB.clear();
           time_base = current_timestamp();
-          map<pair<int, string>, ll> BLsampling = baselineSampler(X, R);
+          StartQGramCount BLsampling = baselineSampler(X, R);
           for (auto w : BLsampling) {
             int u = w.first.first;
             W.insert(w.first.second);
@@ -912,7 +900,7 @@ int main(int argc, char **argv) {
           Rp = 0ll;
 
           time_fsample = current_timestamp();
-          map<pair<int, string>, ll> SamplePlus = randomColorfulSamplePlus(X, R);
+          StartQGramCount SamplePlus = randomColorfulSamplePlus(X, R);
 
           for (auto w : SamplePlus) {
             int u = w.first.first;
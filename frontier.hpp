@@ -0,0 +1,36 @@
+#ifndef _FRONTIER_HPP
+#define _FRONTIER_HPP
+
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+#include <omp.h>
+
+// One level of a parallel frontier expansion, without locks: every thread
+// appends the successors of its entries to its own buffer, and the buffers
+// are then copied in parallel into next, each at its offset (the prefix sum
+// of the buffer sizes). expand(j, out) appends the successors of entry j of
+// the old frontier (of n entries) to out. The order of next depends on the
+// scheduling.
+template <typename T, typename Expand>
+void expandFrontier(size_t n, std::vector<T> &next, Expand expand) {
+  int threads = omp_get_max_threads();
+  std::vector<std::vector<T>> local(threads);
+  std::vector<size_t> offset(threads + 1, 0);
+  next.clear();
+  #pragma omp parallel
+  {
+    int t = omp_get_thread_num();
+    std::vector<T> &out = local[t];
+    #pragma omp for schedule(guided)
+    for (long j = 0; j < (long)n; j++) expand((size_t)j, out);
+    #pragma omp single
+    {
+      for (int i = 0; i < threads; i++) offset[i + 1] = offset[i] + local[i].size();
+      next.resize(offset[threads]);
+    }
+    std::copy(out.begin(), out.end(), next.begin() + offset[t]);
+  }
+}
+
+#endif
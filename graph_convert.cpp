@@ -0,0 +1,88 @@
+/*
+  Author: Gaspare Ferraro
+  Convert a graph in nme, nme.bin or snap format to the CSR format
+  (see graph_read.hpp), which the tools map in memory and use in place
+*/
+#include <bits/stdc++.h>
+#include "graph_read.hpp"
+
+using namespace std;
+
+unsigned int N, E;
+vector<int> labels;
+vector<int> ab;
+
+// nme: "N E", N labels, E edges (text)
+bool readNME(const char *filename) {
+  vector<int> in;
+  if (!readTextInts(filename, in) || in.size() < 2) return false;
+  N = in[0];
+  E = in[1];
+  if (in.size() < 2 + N + 2 * (size_t)E) return false;
+  labels.assign(in.begin() + 2, in.begin() + 2 + N);
+  ab.assign(in.begin() + 2 + N, in.begin() + 2 + N + 2 * (size_t)E);
+  return true;
+}
+
+// nme.bin: N, E, N labels (only if the file is big enough), E edges
+bool readNMEBin(FILE *in) {
+  if (fread(&N, sizeof(int), 1, in) != 1) return false;
+  if (fread(&E, sizeof(int), 1, in) != 1) return false;
+  struct stat st;
+  fstat(fileno(in), &st);
+  size_t withLabels = 2 * sizeof(int) + (N + 2 * (size_t)E) * sizeof(int);
+  if ((size_t)st.st_size >= withLabels) {
+    labels.resize(N);
+    if (fread(labels.data(), sizeof(int), N, in) != N) return false;
+  }
+  ab.resize(2 * (size_t)E);
+  return fread(ab.data(), sizeof(int), ab.size(), in) == ab.size();
+}
+
+// snap: one "a b" edge per line, '#' comments, N = max id + 1
+bool readSnap(const char *filename) {
+  if (!readTextInts(filename, ab)) return false;
+  ab.resize(ab.size() / 2 * 2);
+  N = 0;
+  for (int v : ab) N = max(N, (unsigned int)v + 1);
+  E = ab.size() / 2;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    printf("Usage: %s format input output\n", argv[0]);
+    printf("\tformat, input format (nme, nme.bin, snap)\n");
+    printf("\tinput, filename (- for stdin)\n");
+    printf("\toutput, CSR filename\n");
+    return 1;
+  }
+
+  bool ok;
+  if (strcmp(argv[1], "nme") == 0)
+    ok = readNME(argv[2]);
+  else if (strcmp(argv[1], "snap") == 0)
+    ok = readSnap(argv[2]);
+  else if (strcmp(argv[1], "nme.bin") == 0) {
+    FILE *in = strcmp(argv[2], "-") == 0 ? stdin : fopen(argv[2], "rb");
+    if (in == NULL) {
+      perror("Opening input file");
+      return 1;
+    }
+    ok = readNMEBin(in);
+  } else {
+    printf("Wrong input format (only 'nme', 'nme.bin' or 'snap')\n");
+    return 1;
+  }
+  if (!ok) {
+    printf("Error reading input graph\n");
+    return 1;
+  }
+
+  CSRGraph G;
+  buildCSR(G, N, ab);
+  printf("N = %u | E = %u | arcs = %zu\n", N, E, G.arcs());
+  if (!writeCSR(argv[3], G, labels.empty() ? NULL : labels.data(), NULL))
+    return 1;
+  return 0;
+}
@@ -2,6 +2,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include "graph_read.hpp"
 
 using namespace std;
 
@@ -14,7 +15,7 @@ int main(int argc, char **argv) {
     printf("Usage: %s N M output label A B seed\n", argv[0]);
     printf("\tN, number of nodes\n");
     printf("\tM, number of edges\n");
-    printf("\toutput, filename (optional, default: stdout)\n");
+    printf("\toutput, filename (optional, default: stdout, .csr for CSR format)\n");
     printf("\tA, size of set A (jaccard)\n");
     printf("\tB, size of set B (jaccard)\n");
     printf(
@@ -32,7 +33,10 @@ int main(int argc, char **argv) {
   int sampleS[2] = {0, 0};
   int *sample[2];
 
-  if (argc >= 4 && strcmp(argv[3],"stdout") != 0) {
+  bool csr = argc >= 4 && strlen(argv[3]) > 4 &&
+             strcmp(argv[3] + strlen(argv[3]) - 4, ".csr") == 0;
+
+  if (argc >= 4 && strcmp(argv[3],"stdout") != 0 && !csr) {
     fd = open(argv[3], O_CREAT | O_WRONLY, S_IRUSR | S_IWUSR);
     if (fd == -1) {
       perror("Opening file");
@@ -115,7 +119,12 @@ int main(int argc, char **argv) {
       sample[1][i] = V[N-1-i];
   }
 
-  if (fd != -1) {
+  if (csr) {
+    if (jaccard) printf("CSR format: sets A and B not stored\n");
+    CSRGraph csrG;
+    buildCSR(csrG, N, &toWrite[2], Mc);
+    if (!writeCSR(argv[3], csrG, label > 0 ? labels : NULL, NULL)) return -1;
+  } else if (fd != -1) {
     write(fd, (void *)toWrite, 2 * sizeof(int));
     if (label > 0) write(fd, (void *)labels, N * sizeof(int));
     write(fd, (void *)&toWrite[2], 2 * Mc * sizeof(int));
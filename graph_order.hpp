@@ -0,0 +1,178 @@
+#ifndef _GRAPH_ORDER_HPP
+#define _GRAPH_ORDER_HPP
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include "graph_read.hpp"
+
+// Node orderings improving the locality of the DP: with the nodes relabeled
+// in order, the rows read while scanning the neighbours of a node sit close
+// in memory. An ordering is the vector of the old ids in their new order.
+
+// Highest degree first (hubs, read by most nodes, together)
+inline std::vector<int> degreeOrder(const CSRGraph &G) {
+  std::vector<int> order(G.n);
+  for (unsigned int u = 0; u < G.n; u++) order[u] = u;
+  std::stable_sort(order.begin(), order.end(), [&](int x, int y) {
+    return G.degree(x) > G.degree(y);
+  });
+  return order;
+}
+
+// Reverse Cuthill-McKee: BFS from a lowest degree node of every component,
+// visiting the neighbours by increasing degree, then reversed
+inline std::vector<int> rcmOrder(const CSRGraph &G) {
+  unsigned int n = G.n;
+  std::vector<int> byDegree(n), order;
+  std::vector<char> seen(n, 0);
+  for (unsigned int u = 0; u < n; u++) byDegree[u] = u;
+  auto lessDegree = [&](int x, int y) { return G.degree(x) < G.degree(y); };
+  std::stable_sort(byDegree.begin(), byDegree.end(), lessDegree);
+
+  order.reserve(n);
+  for (int s : byDegree) {
+    if (seen[s]) continue;
+    seen[s] = 1;
+    order.push_back(s);
+    for (size_t h = order.size() - 1; h < order.size(); h++) {
+      size_t first = order.size();
+      for (int v : G[order[h]])
+        if (!seen[v]) {
+          seen[v] = 1;
+          order.push_back(v);
+        }
+      std::stable_sort(order.begin() + first, order.end(), lessDegree);
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+// SlashBurn: remove the k highest degree nodes (hubs) of the giant connected
+// component and number them first; the smaller components the graph falls
+// apart into (spokes) are numbered last, the smallest at the end. Repeat on
+// the giant component until it has at most k nodes. k defaults to n / 200,
+// and doubles after an iteration splitting off fewer nodes than k (graphs
+// with no hub structure would take n / k iterations otherwise). Every
+// iteration is a BFS of the current giant component.
+inline std::vector<int> slashBurnOrder(const CSRGraph &G, size_t k = 0,
+                                       unsigned int *iterations = NULL) {
+  unsigned int n = G.n;
+  if (k == 0) k = std::max((size_t)1, (size_t)n / 200);
+
+  std::vector<int> order(n), deg(n), comp(n, -1), cur(n), next;
+  std::vector<char> alive(n, 1);
+  for (unsigned int u = 0; u < n; u++) {
+    deg[u] = G.degree(u);
+    cur[u] = u;
+  }
+
+  size_t front = 0, back = n;
+  unsigned int it = 0;
+  std::vector<int> queue;
+  std::vector<std::pair<size_t, size_t>> comps;  // (size, start in queue)
+  while (!cur.empty()) {
+    it++;
+
+    // Connected components of cur, in BFS order in queue
+    queue.clear();
+    comps.clear();
+    for (int s : cur) {
+      if (comp[s] == (int)it) continue;
+      size_t start = queue.size();
+      comp[s] = it;
+      queue.push_back(s);
+      for (size_t h = start; h < queue.size(); h++)
+        for (int v : G[queue[h]])
+          if (alive[v] && comp[v] != (int)it) {
+            comp[v] = it;
+            queue.push_back(v);
+          }
+      comps.push_back(std::make_pair(queue.size() - start, start));
+    }
+
+    // Spokes: all but the giant component, from the back, smallest last
+    size_t giant = 0;
+    for (size_t c = 1; c < comps.size(); c++)
+      if (comps[c].first > comps[giant].first) giant = c;
+    std::swap(comps[giant], comps.back());
+    std::stable_sort(comps.begin(), comps.end() - 1);
+    size_t spokes = cur.size() - comps.back().first;
+    for (size_t c = 0; c + 1 < comps.size(); c++) {
+      back -= comps[c].first;
+      for (size_t j = 0; j < comps[c].first; j++) {
+        int u = queue[comps[c].second + j];
+        order[back + j] = u;
+        alive[u] = 0;
+      }
+    }
+
+    next.assign(queue.begin() + comps.back().second,
+                queue.begin() + comps.back().second + comps.back().first);
+    auto moreDegree = [&](int x, int y) {
+      return deg[x] > deg[y] || (deg[x] == deg[y] && x < y);
+    };
+    if (next.size() <= k) {
+      std::sort(next.begin(), next.end(), moreDegree);
+      for (int u : next) order[front++] = u;
+      break;
+    }
+
+    // Slash the hubs
+    std::partial_sort(next.begin(), next.begin() + k, next.end(), moreDegree);
+    for (size_t j = 0; j < k; j++) {
+      int h = next[j];
+      order[front++] = h;
+      alive[h] = 0;
+      for (int v : G[h]) deg[v]--;
+    }
+    cur.assign(next.begin() + k, next.end());
+    if (spokes < k) k *= 2;
+  }
+
+  if (iterations != NULL) *iterations = it;
+  return order;
+}
+
+// Relabel G so that node order[r] becomes node r, keeping the order of every
+// adjacency list; newId[u] is the new id of the old node u
+inline void relabelCSR(CSRGraph &G, const std::vector<int> &order,
+                       std::vector<int> &newId) {
+  unsigned int n = G.n;
+  newId.assign(n, 0);
+  for (unsigned int r = 0; r < n; r++) newId[order[r]] = r;
+
+  std::vector<uint64_t> off(n + 1);
+  std::vector<int> adj(G.m);
+  off[0] = 0;
+  for (unsigned int r = 0; r < n; r++) off[r + 1] = off[r] + G.degree(order[r]);
+
+  #pragma omp parallel for schedule(guided)
+  for (unsigned int r = 0; r < n; r++) {
+    int *a = adj.data() + off[r];
+    for (int v : G[order[r]]) *a++ = newId[v];
+  }
+
+  G.offData.swap(off);
+  G.adjData.swap(adj);
+  G.own();
+}
+
+// Ordering by name (none, degree, rcm, slashburn); false if unknown
+inline bool orderByName(const CSRGraph &G, const char *name,
+                        std::vector<int> &order) {
+  if (strcmp(name, "none") == 0)
+    order.clear();
+  else if (strcmp(name, "degree") == 0)
+    order = degreeOrder(G);
+  else if (strcmp(name, "rcm") == 0)
+    order = rcmOrder(G);
+  else if (strcmp(name, "slashburn") == 0)
+    order = slashBurnOrder(G);
+  else
+    return false;
+  return true;
+}
+
+#endif
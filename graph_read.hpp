@@ -1,6 +1,489 @@
 #ifndef _GRAPH_READ_HPP
 #define _GRAPH_READ_HPP
 
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Neighbours of a node: a view over the adjacency array of a CSRGraph
+struct AdjList {
+  const int *b, *e;
+
+  const int *begin() const { return b; }
+  const int *end() const { return e; }
+  size_t size() const { return e - b; }
+  bool empty() const { return b == e; }
+  int operator[](size_t i) const { return b[i]; }
+
+  // Only on a sorted graph (see CSRGraph::sort)
+  bool contains(int v) const { return std::binary_search(b, e, v); }
+};
+
+// Slot of a row of k entries replacing row u of a loose CSR array (rows
+// [off[u], end[u]) that can grow in place up to room[u]): in place if it
+// fits, else at the end of the array, of size size, with room for k more.
+// Sets off[u] / end[u] and grows size.
+inline uint64_t rowSlot(uint64_t *off, uint64_t *end, uint64_t *room, size_t u,
+                        size_t k, size_t &size) {
+  if (off[u] + k > room[u]) {
+    off[u] = size;
+    room[u] = size + 2 * k;
+    size = room[u];
+  }
+  end[u] = off[u] + k;
+  return off[u];
+}
+
+// Graph in compressed sparse row form: the neighbours of u are
+// adj[off[u]..end[u]). The arrays are either owned (offData, adjData) or
+// point into a mapped graph file (see mapCSR). A compact graph has its rows
+// in node order without gaps, end = off + 1; updateCSR makes it loose, with
+// the row ends in endData and the changed rows moved out of place.
+struct CSRGraph {
+  unsigned int n;
+  size_t m;  // number of arcs
+  uint64_t *off;
+  uint64_t *end;
+  int *adj;
+  std::vector<uint64_t> offData;
+  std::vector<uint64_t> endData, roomData;  // only if loose
+  std::vector<int> adjData;
+
+  CSRGraph() : n(0), m(0), off(NULL), end(NULL), adj(NULL) {}
+  CSRGraph(const CSRGraph &o) { *this = o; }
+
+  CSRGraph &operator=(const CSRGraph &o) {
+    n = o.n;
+    m = o.m;
+    offData = o.offData;
+    endData = o.endData;
+    roomData = o.roomData;
+    adjData = o.adjData;
+    bool owned = o.off == o.offData.data();
+    off = owned ? offData.data() : o.off;
+    end = compact() ? off + 1 : endData.data();
+    adj = owned ? adjData.data() : o.adj;
+    return *this;
+  }
+
+  AdjList operator[](size_t u) const {
+    AdjList l = {adj + off[u], adj + end[u]};
+    return l;
+  }
+  size_t degree(size_t u) const { return end[u] - off[u]; }
+  size_t arcs() const { return m; }
+  bool compact() const { return endData.empty(); }
+
+  // Point to the owned arrays, compact
+  void own() {
+    std::vector<uint64_t>().swap(endData);
+    std::vector<uint64_t>().swap(roomData);
+    off = offData.data();
+    end = off + 1;
+    adj = adjData.data();
+  }
+
+  // Owned arrays with the row ends apart, so that rows can move
+  void loosen() {
+    if (!compact() || n == 0) return;
+    if (off != offData.data()) {
+      offData.assign(off, off + n + 1);
+      adjData.assign(adj, adj + off[n]);
+    }
+    endData.assign(offData.begin() + 1, offData.end());
+    roomData = endData;
+    off = offData.data();
+    end = endData.data();
+    adj = adjData.data();
+  }
+
+  // Rows back in node order without gaps
+  void pack() {
+    if (compact()) return;
+    std::vector<uint64_t> o(n + 1);
+    o[0] = 0;
+    for (size_t u = 0; u < n; u++) o[u + 1] = o[u] + degree(u);
+    std::vector<int> a(o[n]);
+    #pragma omp parallel for schedule(guided)
+    for (size_t u = 0; u < n; u++) std::copy(adj + off[u], adj + end[u], a.begin() + o[u]);
+    offData.swap(o);
+    adjData.swap(a);
+    own();
+  }
+
+  // Sort every adjacency list
+  void sort() {
+    #pragma omp parallel for schedule(guided)
+    for (size_t u = 0; u < n; u++) std::sort(adj + off[u], adj + end[u]);
+  }
+
+  // Sort every adjacency list and drop repeated neighbours
+  void simplify() {
+    pack();
+    sort();
+    size_t k = 0, b = 0;
+    for (size_t u = 0; u < n; u++) {
+      size_t e = off[u + 1];
+      for (size_t j = b; j < e; j++)
+        if (j == b || adj[j] != adj[j - 1]) adj[k++] = adj[j];
+      b = e;
+      off[u + 1] = k;
+    }
+    m = k;
+  }
+};
+
+inline int csrThreads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// Build G with n nodes from the m edges (ab[2i], ab[2i+1]), each added in
+// both directions unless directed. Neighbours keep the order of the input.
+// The edges are split in blocks, one per thread: every block counts the arcs
+// of each node, the counts give every block its own insertion points (after
+// the earlier blocks), then the blocks fill adj in parallel.
+inline void buildCSR(CSRGraph &G, unsigned int n, const int *ab, size_t m,
+                     bool directed = false) {
+  std::vector<uint64_t> &off = G.offData;
+  std::vector<int> &adj = G.adjData;
+
+  // At most 2m / n blocks, so the counters take no more than adj
+  size_t B = csrThreads();
+  if (n > 0 && B * n > 2 * m) B = std::max((size_t)1, 2 * m / n);
+  std::vector<uint32_t> cnt(B * n, 0);  // arcs of u in block b: cnt[b*n + u]
+
+  #pragma omp parallel for schedule(static, 1)
+  for (size_t b = 0; b < B; b++) {
+    uint32_t *c = &cnt[b * n];
+    for (size_t i = b * m / B; i < (b + 1) * m / B; i++) {
+      c[ab[2 * i]]++;
+      if (!directed) c[ab[2 * i + 1]]++;
+    }
+  }
+
+  off.assign(n + 1, 0);
+  #pragma omp parallel for schedule(static)
+  for (size_t u = 0; u < n; u++) {
+    uint32_t s = 0;
+    for (size_t b = 0; b < B; b++) {
+      uint32_t t = cnt[b * n + u];
+      cnt[b * n + u] = s;
+      s += t;
+    }
+    off[u + 1] = s;
+  }
+  for (size_t u = 0; u < n; u++) off[u + 1] += off[u];
+  adj.resize(off[n]);
+
+  #pragma omp parallel for schedule(static, 1)
+  for (size_t b = 0; b < B; b++) {
+    uint32_t *c = &cnt[b * n];
+    for (size_t i = b * m / B; i < (b + 1) * m / B; i++) {
+      int x = ab[2 * i], y = ab[2 * i + 1];
+      adj[off[x] + c[x]++] = y;
+      if (!directed) adj[off[y] + c[y]++] = x;
+    }
+  }
+
+  G.n = n;
+  G.m = adj.size();
+  G.own();
+}
+
+inline void buildCSR(CSRGraph &G, unsigned int n, const std::vector<int> &ab,
+                     bool directed = false) {
+  buildCSR(G, n, ab.data(), ab.size() / 2, directed);
+}
+
+// Apply to G a batch of insertions ins and deletions del of undirected
+// edges (node pairs, as for buildCSR). A deleted edge loses one arc in each
+// direction; the inserted ones are appended in batch order, or put in order
+// if sorted (for a sorted graph, see CSRGraph::sort). The deletions refer to
+// the edges before the batch: false, with G unchanged, if one is missing.
+// Only the rows of the endpoints are rewritten, in place or moved to the end
+// of adj (see rowSlot), so a batch costs the degrees of its endpoints. G is
+// loose after, and packed again when the gaps outgrow the arcs.
+inline bool updateCSR(CSRGraph &G, const std::vector<int> &ins,
+                      const std::vector<int> &del, bool sorted = false) {
+  typedef std::pair<int, int> Arc;
+  std::vector<Arc> add, rem;
+  for (size_t i = 0; i + 1 < ins.size(); i += 2) {
+    add.push_back(Arc(ins[i], ins[i + 1]));
+    add.push_back(Arc(ins[i + 1], ins[i]));
+  }
+  for (size_t i = 0; i + 1 < del.size(); i += 2) {
+    rem.push_back(Arc(del[i], del[i + 1]));
+    rem.push_back(Arc(del[i + 1], del[i]));
+  }
+  std::stable_sort(add.begin(), add.end(),
+                   [](const Arc &a, const Arc &b) { return a.first < b.first; });
+  std::sort(rem.begin(), rem.end());
+
+  // The new rows of the endpoints
+  std::vector<int> nodes;
+  std::vector<std::vector<int>> rows;
+  size_t ia = 0, ir = 0;
+  std::vector<int> r;
+  while (ia < add.size() || ir < rem.size()) {
+    int u = ir == rem.size() || (ia < add.size() && add[ia].first < rem[ir].first)
+                ? add[ia].first
+                : rem[ir].first;
+    r.clear();
+    for (; ir < rem.size() && rem[ir].first == u; ir++) r.push_back(rem[ir].second);
+    nodes.push_back(u);
+    rows.push_back(std::vector<int>());
+    std::vector<int> &a = rows.back();
+    for (int v : G[u]) {
+      std::vector<int>::iterator it = std::lower_bound(r.begin(), r.end(), v);
+      if (it != r.end() && *it == v)
+        r.erase(it);
+      else
+        a.push_back(v);
+    }
+    if (!r.empty()) return false;
+    for (; ia < add.size() && add[ia].first == u; ia++) a.push_back(add[ia].second);
+    if (sorted) std::sort(a.begin(), a.end());
+  }
+
+  G.loosen();
+  size_t size = G.adjData.size();
+  for (size_t j = 0; j < nodes.size(); j++) {
+    G.m += rows[j].size();
+    G.m -= G.degree(nodes[j]);
+    uint64_t b = rowSlot(G.off, G.end, G.roomData.data(), nodes[j], rows[j].size(), size);
+    G.adjData.resize(size);
+    std::copy(rows[j].begin(), rows[j].end(), G.adjData.begin() + b);
+  }
+  G.adj = G.adjData.data();
+  if (G.adjData.size() > 2 * G.m + G.n) G.pack();
+  return true;
+}
+
+// Append to out the integers in [p, e). Anything else separates them, '#'
+// starts a comment up to the end of the line (SNAP headers).
+inline void parseInts(const char *p, const char *e, std::vector<int> &out) {
+  while (p < e) {
+    char c = *p;
+    if (c == '#') {
+      while (p < e && *p != '\n') p++;
+      continue;
+    }
+    bool neg = c == '-';
+    if (neg) p++;
+    if (p == e || *p < '0' || *p > '9') {
+      if (!neg) p++;
+      continue;
+    }
+    long long v = 0;
+    while (p < e && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+    out.push_back(neg ? (int)-v : (int)v);
+  }
+}
+
+// Read all the integers of a text graph (nme, SNAP edge list, ...) from
+// filename, or stdin if NULL or "-". The input is mapped in memory when
+// possible, split in chunks at line boundaries and parsed in parallel.
+inline bool readTextInts(const char *filename, std::vector<int> &out) {
+  bool useStdin = filename == NULL || strcmp(filename, "-") == 0;
+  int fd = useStdin ? 0 : open(filename, O_RDONLY);
+  if (fd == -1) {
+    perror("Error opening input file");
+    return false;
+  }
+
+  const char *data = NULL;
+  size_t size = 0;
+  void *base = MAP_FAILED;
+  std::vector<char> buffer;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    size = st.st_size;
+    base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base != MAP_FAILED) {
+      madvise(base, size, MADV_SEQUENTIAL);
+      data = (const char *)base;
+    }
+  }
+  if (base == MAP_FAILED) {
+    // Pipe (or mmap not possible): read everything
+    size_t got = 0;
+    ssize_t r;
+    buffer.resize(1 << 20);
+    while ((r = read(fd, &buffer[got], buffer.size() - got)) > 0) {
+      got += r;
+      if (got == buffer.size()) buffer.resize(2 * got);
+    }
+    if (r == -1) {
+      perror("Error reading input file");
+      if (!useStdin) close(fd);
+      return false;
+    }
+    data = buffer.data();
+    size = got;
+  }
+  if (!useStdin) close(fd);
+
+  // Chunks of at least 1MB, a few per thread; each one starts after a '\n'
+  size_t C = std::min((size_t)4 * csrThreads(), std::max((size_t)1, size >> 20));
+  std::vector<size_t> from(C + 1);
+  for (size_t c = 0; c <= C; c++) {
+    size_t p = c == C ? size : c * size / C;
+    if (c > 0 && c < C) {
+      const char *nl = (const char *)memchr(data + p, '\n', size - p);
+      p = nl == NULL ? size : nl - data + 1;
+    }
+    from[c] = std::max(p, c > 0 ? from[c - 1] : 0);
+  }
+
+  std::vector<std::vector<int>> part(C);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (size_t c = 0; c < C; c++) {
+    part[c].reserve((from[c + 1] - from[c]) / 4);
+    parseInts(data + from[c], data + from[c + 1], part[c]);
+  }
+
+  std::vector<size_t> pos(C + 1, 0);
+  for (size_t c = 0; c < C; c++) pos[c + 1] = pos[c] + part[c].size();
+  out.resize(pos[C]);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (size_t c = 0; c < C; c++) {
+    std::copy(part[c].begin(), part[c].end(), out.begin() + pos[c]);
+    std::vector<int>().swap(part[c]);
+  }
+
+  if (base != MAP_FAILED) munmap(base, size);
+  return true;
+}
+
+// CSR graph file (.csr), version 1, native endianness:
+//   CSRHeader
+//   uint64_t off[n + 1]
+//   int32_t  adj[arcs]      (padded to 8 bytes)
+//   int32_t  labels[n]      if flags & CSR_LABELS
+//   int32_t  colors[n]      if flags & CSR_COLORS
+#define CSR_MAGIC "CSRG"
+#define CSR_VERSION 1
+#define CSR_LABELS 1
+#define CSR_COLORS 2
+
+struct CSRHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t n;
+  uint32_t flags;
+  uint64_t arcs;
+};
+
+inline size_t csrAdjBytes(uint64_t arcs) {
+  return (arcs * sizeof(int32_t) + 7) & ~(size_t)7;
+}
+
+// True if filename starts with the CSR magic
+inline bool isCSRFile(const char *filename) {
+  char magic[4];
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL) return false;
+  bool ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, CSR_MAGIC, 4) == 0;
+  fclose(f);
+  return ok;
+}
+
+// Write G (compact, see CSRGraph::pack) and labels / colors, if not NULL, in
+// CSR format
+inline bool writeCSR(const char *filename, const CSRGraph &G,
+                     const int *labels, const int *colors) {
+  FILE *f = fopen(filename, "wb");
+  if (f == NULL) {
+    perror("Error opening output file");
+    return false;
+  }
+  CSRHeader h;
+  memcpy(h.magic, CSR_MAGIC, 4);
+  h.version = CSR_VERSION;
+  h.n = G.n;
+  h.flags = (labels ? CSR_LABELS : 0) | (colors ? CSR_COLORS : 0);
+  h.arcs = G.m;
+
+  const char pad[8] = {0};
+  size_t padding = csrAdjBytes(G.m) - G.m * sizeof(int32_t);
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+  ok = ok && fwrite(G.off, sizeof(uint64_t), G.n + 1, f) == G.n + 1;
+  ok = ok && fwrite(G.adj, sizeof(int32_t), G.m, f) == G.m;
+  ok = ok && fwrite(pad, 1, padding, f) == padding;
+  if (labels) ok = ok && fwrite(labels, sizeof(int32_t), G.n, f) == G.n;
+  if (colors) ok = ok && fwrite(colors, sizeof(int32_t), G.n, f) == G.n;
+  if (fclose(f) != 0) ok = false;
+  if (!ok) perror("Error writing output file");
+  return ok;
+}
+
+// Map a CSR file in memory and point G (and labels / colors, NULL if the
+// file has none) into it. The mapping is private: changes (e.g. sort) are
+// not written back. It stays mapped until the process exits.
+inline bool mapCSR(const char *filename, CSRGraph &G, const int **labels,
+                   const int **colors) {
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) {
+    perror("Error opening input file");
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(CSRHeader)) {
+    fprintf(stderr, "Invalid CSR file %s\n", filename);
+    close(fd);
+    return false;
+  }
+  void *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror("Error mapping input file");
+    return false;
+  }
+
+  const CSRHeader *h = (const CSRHeader *)base;
+  size_t size = sizeof(CSRHeader);
+  if (memcmp(h->magic, CSR_MAGIC, 4) == 0 && h->version == CSR_VERSION) {
+    size += (h->n + 1) * sizeof(uint64_t) + csrAdjBytes(h->arcs);
+    if (h->flags & CSR_LABELS) size += h->n * sizeof(int32_t);
+    if (h->flags & CSR_COLORS) size += h->n * sizeof(int32_t);
+  }
+  if (memcmp(h->magic, CSR_MAGIC, 4) != 0 || h->version != CSR_VERSION ||
+      size > (size_t)st.st_size) {
+    fprintf(stderr, "Invalid CSR file %s\n", filename);
+    munmap(base, st.st_size);
+    return false;
+  }
 
+  char *p = (char *)base + sizeof(CSRHeader);
+  G.offData.clear();
+  G.adjData.clear();
+  G.own();
+  G.n = h->n;
+  G.m = h->arcs;
+  G.off = (uint64_t *)p;
+  G.end = G.off + 1;
+  p += (h->n + 1) * sizeof(uint64_t);
+  G.adj = (int *)p;
+  p += csrAdjBytes(h->arcs);
+  if (labels) *labels = (h->flags & CSR_LABELS) ? (const int *)p : NULL;
+  if (h->flags & CSR_LABELS) p += h->n * sizeof(int32_t);
+  if (colors) *colors = (h->flags & CSR_COLORS) ? (const int *)p : NULL;
+  return true;
+}
 
 #endif
@@ -4,13 +4,14 @@
   con la tecnica del color-coding
 */
 #include <bits/stdc++.h>
+#include "graph_read.hpp"
 
 using namespace std;
 typedef long long ll;
 
 unsigned int N, M, k, kp;
 int *color;
-set<int> *G;
+CSRGraph G;
 
 inline int nextInt() {
   int r;
@@ -51,7 +52,7 @@ void list_k_induced_path(vector<int> ps, ll cs, int x) {
     for (int v : N) {
       bool induced = true;
       for (int i = 0; i < (int)ps.size() - 1 && induced; i++) {
-        if (G[ps[i]].find(v) != G[ps[i]].end()) induced = false;
+        if (G[ps[i]].contains(v)) induced = false;
       }
       if (!induced) continue;
       ps.push_back(v);
@@ -110,19 +111,15 @@ int main(int argc, char **argv) {
   kp = atol(argv[2]);
 
   color = new int[N + 1];
-  G = new set<int>[N + 1];
-
-  for (unsigned int i = 0; i < M; i++) {
-    int a = nextInt();
-    int b = nextInt();
-    G[a].insert(b);
-    G[b].insert(a);
-  }
+  vector<int> ab(2 * M);
+  for (unsigned int i = 0; i < 2 * M; i++) ab[i] = nextInt();
 
   for (unsigned int i = 0; i < N; i++) {
-    G[N].insert(i);
-    G[i].insert(N);
+    ab.push_back(N);
+    ab.push_back(i);
   }
+  buildCSR(G, N + 1, ab);
+  G.simplify();
 
   randomColor();
   color[N] = kp;
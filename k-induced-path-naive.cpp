@@ -4,11 +4,12 @@
   con una dfs
 */
 #include <bits/stdc++.h>
+#include "graph_read.hpp"
 
 using namespace std;
 
 int N, M, k;
-set<int> *G;
+CSRGraph G;
 
 int nextInt() {
   int tmp;
@@ -23,7 +24,7 @@ long long cont = 0;
 void dfs(int a) {
   bool induced = true;
   for (int i = 0; i < (int)path.size() - 1 && induced; i++) {
-    if (G[path[i]].find(a) != G[path[i]].end()) induced = false;
+    if (G[path[i]].contains(a)) induced = false;
   }
   if (!induced) return;
   path.push_back(a);
@@ -52,15 +53,12 @@ int main(int argc, char **argv) {
   N = nextInt();
   M = nextInt();
 
-  G = new set<int>[N];
   in = new bool[N];
 
-  for (int i = 0; i < M; i++) {
-    int a = nextInt();
-    int b = nextInt();
-    G[a].insert(b);
-    G[b].insert(a);
-  }
+  vector<int> ab(2 * M);
+  for (int i = 0; i < 2 * M; i++) ab[i] = nextInt();
+  buildCSR(G, N, ab);
+  G.simplify();
 
   for (int i = 0; i < N; i++) dfs(i);
   printf("%llu\n", cont);
@@ -20,6 +20,8 @@
 #include <omp.h>
 #include <getopt.h>
 #include <unistd.h>
+#include "graph_read.hpp"
+#include "dp_layer.hpp"
 
 #ifdef K_8
 #define MAXK 8
@@ -46,7 +48,7 @@ static int verbose_flag, help_flag;
 ll cont = 0;
 char *labels;
 int *color;
-vector<int> *G;
+CSRGraph G;
 
 inline int nextInt() {
   int r;
@@ -77,28 +79,15 @@ inline void randomColor() {
 }
 
 // Dynamic programming processing
-map<COLORSET, ll> *DP[MAXK + 1];
+DPLayer<COLORSET> DP[MAXK + 1];
 
 void processDP() {
   if (verbose_flag) printf("K = %u\n", 1);
-  for (unsigned int u = 0; u < N; u++) DP[1][u][setBit(0, color[u])] = 1;
+  initLayer(DP[1], N, color);
 
   for (unsigned int i = 2; i <= k; i++) {
     if (verbose_flag) printf("K = %u\n", i);
-#pragma omp parallel for
-    for (unsigned int u = 0; u < N; u++) {
-      for (int v : G[u]) {
-        for (auto d : DP[i - 1][v]) {
-          COLORSET s = d.first;
-          ll f = d.second;
-
-          if (getBit(s, color[u])) continue;
-
-          ll fp = DP[i][u][setBit(s, color[u])];
-          DP[i][u][setBit(s, color[u])] = f + fp;
-        }
-      }
-    }
+    buildLayer(DP[i], DP[i - 1], N, G, color);
   }
 }
 
@@ -117,11 +106,11 @@ set<string> sample() {
       ll last = 0ll;
       ll sum = 0ll;
       for (int v : G[u]) {
-        auto it = DP[i][v].find(kD);
-        if (it != DP[i][v].end()) {
+        ll f = DP[i].get(v, kD);
+        if (f) {
           A.push_back(v);
           freqA.push_back(last);
-          last = (*it).second;
+          last = f;
           sum += last;
         }
       }
@@ -260,6 +249,7 @@ int main(int argc, char **argv) {
   }
   if (verbose_flag) printf("Reading graph...\n");
 
+  vector<int> ab;
   if (input_graph_flag) {
     if (input_graph == NULL) {
       printf("Input file name missing!\n");
@@ -276,18 +266,12 @@ int main(int argc, char **argv) {
 
     color = new int[N];
     labels = new char[N];
-    G = new vector<int>[N + 1];
-
     read(input_fd, labels, N * sizeof(char));
 
     for (unsigned int i = 0; i < N; i++) labels[i] += 'A';
 
-    int ab[2];
-    for (unsigned int i = 0; i < M; i++) {
-      read(input_fd, ab, 2 * sizeof(int));
-      G[ab[0]].push_back(ab[1]);
-      G[ab[1]].push_back(ab[0]);
-    }
+    ab.resize(2 * M);
+    read(input_fd, ab.data(), 2 * M * sizeof(int));
 
   } else {
     // Read from stdin, nme format
@@ -296,25 +280,29 @@ int main(int argc, char **argv) {
 
     color = new int[N];
     labels = new char[N];
-    G = new vector<int>[N + 1];
-
     for (unsigned int i = 0; i < N; i++) labels[i] = 'A' + nextInt();
 
-    for (unsigned int i = 0; i < M; i++) {
-      int a = nextInt();
-      int b = nextInt();
-      G[a].push_back(b);
-      G[b].push_back(a);
-    }
+    ab.resize(2 * M);
+    for (unsigned int i = 0; i < 2 * M; i++) ab[i] = nextInt();
   }
 
-  for (unsigned i = 0; i < N; i++) G[N].push_back(i);
+  // Both directions of every edge plus the arcs from the fake node N
+  vector<int> arcs;
+  arcs.reserve(4 * M + 2 * N);
+  for (unsigned int i = 0; i < M; i++) {
+    arcs.push_back(ab[2 * i]);
+    arcs.push_back(ab[2 * i + 1]);
+    arcs.push_back(ab[2 * i + 1]);
+    arcs.push_back(ab[2 * i]);
+  }
+  for (unsigned int i = 0; i < N; i++) {
+    arcs.push_back(N);
+    arcs.push_back(i);
+  }
+  buildCSR(G, N + 1, arcs, true);
 
   if (verbose_flag) printf("N = %d | M = %d\n", N, M);
 
-  // Create DP Table
-  for (unsigned int i = 0; i <= k; i++) DP[i] = new map<COLORSET, ll>[N];
-
   // Random color graph
   if (verbose_flag) printf("Random coloring graph...\n");
   randomColor();
@@ -48,6 +48,7 @@ Sketches[u]=freq[u].set() //Skecthes[u] are the pairs <\pi,f> in freq[u]
 #include <omp.h>
 #include <getopt.h>
 #include <unistd.h>
+#include "graph_read.hpp"
 
 #ifdef K_8
 #define MAXK 8
@@ -75,7 +76,7 @@ static int verbose_flag, help_flag;
 ll cont = 0;
 char *labels;
 int *color;
-vector<int> *G;
+CSRGraph G;
 
 inline int nextInt() {
   int r;
@@ -366,19 +367,14 @@ int main(int argc, char **argv) {
 
     color = new int[N];
     labels = new char[N];
-    G = new vector<int>[N];
-
     read(input_fd, labels, N*sizeof(char));
 
     for(unsigned int i=0; i<N; i++)
       labels[i] += 'A';
 
-    int ab[2];
-    for (unsigned int i = 0; i < M; i++) {
-      read(input_fd, ab, 2 * sizeof(int));
-      G[ab[0]].push_back(ab[1]);
-      G[ab[1]].push_back(ab[0]);
-    }
+    vector<int> ab(2 * M);
+    read(input_fd, ab.data(), 2 * M * sizeof(int));
+    buildCSR(G, N, ab);
 
   } else {
     // Read from stdin, nme format
@@ -387,17 +383,12 @@ int main(int argc, char **argv) {
 
     color = new int[N];
     labels = new char[N];
-    G = new vector<int>[N];
-
     for(unsigned int i = 0; i<N; i++)
       labels[i] = 'A'+nextInt();
 
-    for (unsigned int i = 0; i < M; i++) {
-      int a = nextInt();
-      int b = nextInt();
-      G[a].push_back(b);
-      G[b].push_back(a);
-    }
+    vector<int> ab(2 * M);
+    for (unsigned int i = 0; i < 2 * M; i++) ab[i] = nextInt();
+    buildCSR(G, N, ab);
   }
 
   if (verbose_flag) printf("N = %d | M = %d\n", N, M);
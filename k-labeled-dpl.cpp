@@ -18,6 +18,7 @@
 #include <omp.h>
 #include <getopt.h>
 #include <unistd.h>
+#include "graph_read.hpp"
 
 #ifdef K_8
 #define MAXK 8
@@ -45,7 +46,7 @@ static int verbose_flag, help_flag;
 ll cont = 0;
 char *labels;
 int *color;
-vector<int> *G;
+CSRGraph G;
 
 inline int nextInt() {
   int r;
@@ -218,19 +219,14 @@ int main(int argc, char **argv) {
 
     color = new int[N];
     labels = new char[N];
-    G = new vector<int>[N];
-
     read(input_fd, labels, N*sizeof(char));
 
     for(unsigned int i=0; i<N; i++)
       labels[i] += 'A';
 
-    int ab[2];
-    for (unsigned int i = 0; i < M; i++) {
-      read(input_fd, ab, 2 * sizeof(int));
-      G[ab[0]].push_back(ab[1]);
-      G[ab[1]].push_back(ab[0]);
-    }
+    vector<int> ab(2 * M);
+    read(input_fd, ab.data(), 2 * M * sizeof(int));
+    buildCSR(G, N, ab);
 
   } else {
     // Read from stdin, nme format
@@ -239,17 +235,12 @@ int main(int argc, char **argv) {
 
     color = new int[N];
     labels = new char[N];
-    G = new vector<int>[N];
-
     for(unsigned int i = 0; i<N; i++)
       labels[i] = 'A'+nextInt();
 
-    for (unsigned int i = 0; i < M; i++) {
-      int a = nextInt();
-      int b = nextInt();
-      G[a].push_back(b);
-      G[b].push_back(a);
-    }
+    vector<int> ab(2 * M);
+    for (unsigned int i = 0; i < 2 * M; i++) ab[i] = nextInt();
+    buildCSR(G, N, ab);
   }
 
   if (verbose_flag) printf("N = %d | M = %d\n", N, M);
@@ -16,6 +16,8 @@
 #include <omp.h>
 #include <getopt.h>
 #include <unistd.h>
+#include "graph_read.hpp"
+#include "qgram.hpp"
 
 #ifdef K_8
 #define MAXK 8
@@ -42,10 +44,13 @@ static int verbose_flag, help_flag;
 
 ll cont = 0;
 char *labels;
+unsigned int labelBits = 1;  // bits per symbol in a QGram
 int *color;
-vector<int> *G;
+CSRGraph G;
 
-set<string> W;
+// Prefixes of the sampled paths by length, packed
+vector<QGramSet> W;
+size_t words = 0;
 
 inline int nextInt() {
   int r;
@@ -68,13 +73,14 @@ inline void randomColor() {
 }
 
 // Dynamic programming processing
-map< pair<COLORSET, string>, ll > *DP[MAXK+1];
+typedef unordered_map<pair<COLORSET, QGram>, ll, QGramHash> LabelDP;
+LabelDP *DP[MAXK+1];
 
 void processDP() {
 
     if( verbose_flag ) printf("K = %u\n", 1);
     for(unsigned int u=0; u<N; u++)
-      DP[1][u][ make_pair( setBit(0, color[u] ), string(&labels[u], 1) ) ] = 1;
+      DP[1][u][ make_pair( setBit(0, color[u] ), (QGram)(labels[u] - 'A') ) ] = 1;
 
     for(unsigned int i=2; i <= k; i++)
     {
@@ -84,23 +90,18 @@ void processDP() {
       {
         for(int v : G[u])
         {
-          for(auto d : DP[i-1][v])
+          for(auto &d : DP[i-1][v])
           {
             COLORSET s = d.first.first;
-            string l = d.first.second;
+            QGram l = d.first.second;
             ll f = d.second;
             if( getBit(s, color[u]) ) continue;
 
             COLORSET su = setBit(s, color[u]);
-            string lu = string(l);
-            lu += labels[u];
-            ll fp = DP[i][u][ make_pair( setBit(s, color[u]), lu ) ];
+            QGram lu = qgramPush(l, labels[u] - 'A', labelBits);
+            if( !W[i].count(lu) ) continue;
 
-            auto it = W.lower_bound(lu);
-            if( it == W.end() ) continue;
-            if( mismatch(lu.begin(), lu.end(), (*it).begin()).first != lu.end() ) continue;
-
-            DP[i][u][make_pair(su, lu)] = f+fp;
+            DP[i][u][make_pair(su, lu)] += f;
           }
         }
       }
@@ -236,19 +237,14 @@ int main(int argc, char **argv) {
 
     color = new int[N];
     labels = new char[N];
-    G = new vector<int>[N];
-
     read(input_fd, labels, N*sizeof(char));
 
     for(unsigned int i=0; i<N; i++)
       labels[i] += 'A';
 
-    int ab[2];
-    for (unsigned int i = 0; i < M; i++) {
-      read(input_fd, ab, 2 * sizeof(int));
-      G[ab[0]].push_back(ab[1]);
-      G[ab[1]].push_back(ab[0]);
-    }
+    vector<int> ab(2 * M);
+    read(input_fd, ab.data(), 2 * M * sizeof(int));
+    buildCSR(G, N, ab);
 
   } else {
     // Read from stdin, nme format
@@ -257,17 +253,12 @@ int main(int argc, char **argv) {
 
     color = new int[N];
     labels = new char[N];
-    G = new vector<int>[N];
-
     for(unsigned int i = 0; i<N; i++)
       labels[i] = 'A'+nextInt();
 
-    for (unsigned int i = 0; i < M; i++) {
-      int a = nextInt();
-      int b = nextInt();
-      G[a].push_back(b);
-      G[b].push_back(a);
-    }
+    vector<int> ab(2 * M);
+    for (unsigned int i = 0; i < 2 * M; i++) ab[i] = nextInt();
+    buildCSR(G, N, ab);
   }
 
   if (verbose_flag) printf("N = %d | M = %d\n", N, M);
@@ -287,12 +278,25 @@ int main(int argc, char **argv) {
   char * line = NULL;
   size_t len = 0;
   ssize_t read;
+  // only the prefixes up to k of the paths are matched; a path with a
+  // symbol of no node label matches nothing
+  labelBits = qgramBits(labels, N, 'A');
+  if (k * labelBits > 8 * sizeof(QGram)) {
+    printf("Path labels of length %u do not fit in %zu bits\n", k, 8 * sizeof(QGram));
+    return 1;
+  }
+  W.resize(k + 1);
   while ( !feof(fd_w) && (read = getline(&line, &len, fd_w)) > 1 ) {
     line[read-1] = '\0';
-    W.insert( string(line) );
+    string w(line);
+    QGram g;
+    if (w.size() > k) w.resize(k);
+    words++;
+    if (!qgramOf(w, labelBits, 'A', g)) continue;
+    for (size_t i = w.size(); i > 0; i--, g = qgramPop(g, labelBits)) W[i].insert(g);
   }
 
-  if( verbose_flag ) printf("%zu string in W!\n", W.size());
+  if( verbose_flag ) printf("%zu string in W!\n", words);
 
   if( x >= (int) N )
   {
@@ -302,7 +306,7 @@ int main(int argc, char **argv) {
 
   // Create DP Table
   for (unsigned int i = 0; i <= k; i++)
-    DP[i] = new map< pair<COLORSET, string>, ll >[N];
+    DP[i] = new LabelDP[N];
 
   // Random color graph
   if (verbose_flag) printf("Random coloring graph...\n");
@@ -317,10 +321,11 @@ int main(int argc, char **argv) {
   {
     ll cont = 0;
     printf("Tuple<ColorSet, String, Frequency> from node %d:\n", x);
-    for(auto v : DP[k][x] )
+    for(auto &v : DP[k][x] )
     {
       cont += v.second;
-      printf("\tC=%d S=%s F=%llu\n", v.first.first, v.first.second.c_str(), v.second );
+      printf("\tC=%d S=%s F=%llu\n", v.first.first,
+             qgramString(v.first.second, k, labelBits, 'A').c_str(), v.second );
     }
     if( verbose_flag ) printf("%llu k-labeled colorful-path", cont);
   }
@@ -4,6 +4,9 @@
   using the color-coding technique (parallel version)
 */
 #include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
 #include <set>
 #include <unordered_set>
 #include <unordered_map>
@@ -14,6 +17,7 @@
 #include <omp.h>
 #include <getopt.h>
 #include <unistd.h>
+#include "graph_read.hpp"
 
 #ifdef K_8
 #define MAXK 8
@@ -39,13 +43,7 @@ static int verbose_flag, help_flag;
 
 ll cont = 0;
 int *color;
-vector<int> *G;
-
-inline int nextInt() {
-  int r;
-  scanf("%d", &r);
-  return r;
-}
+CSRGraph G;
 
 // Get pos-th bit in n
 bool getBit(COLORSET n, int pos) { return ((n >> pos) & 1) == 1; }
@@ -284,6 +282,7 @@ int main(int argc, char **argv) {
   }
   if (verbose_flag) printf("Reading graph...\n");
 
+  vector<int> edges;
   if (input_graph_flag) {
     if (input_graph == NULL) {
       printf("Input file name missing!\n");
@@ -294,35 +293,24 @@ int main(int argc, char **argv) {
       return 1;
     }
     if (strcmp(format_name, "snap") == 0) {
-      FILE *input_fd = fopen(input_graph, "r");
-      if (input_fd == NULL) {
-        perror("Error opening input file");
-        return 1;
-      }
-      set<pair<int, int> > edge;
-      char *buffer = NULL;
-      size_t n;
-      int ab[2];
+      vector<int> in;
+      if (!readTextInts(input_graph, in)) return 1;
+      vector<pair<int, int> > edge(in.size() / 2);
       N = 0;
-      do {
-        if( buffer != NULL ) free(buffer);
-        buffer = NULL;
-        n = 0;
-        int line_length = ::getline(&buffer, &n, input_fd);
-        if (line_length == 0) continue;
-        if (buffer[0] == '#') continue;
-        sscanf(buffer, "%d %d", ab, ab + 1);
-        edge.insert(make_pair(ab[0], ab[1]));
-        N = (unsigned)ab[0] > N ? ab[0] : N;
-        N = (unsigned)ab[1] > N ? ab[1] : N;
-      } while (!feof(input_fd));
+      for (size_t i = 0; i < edge.size(); i++) {
+        edge[i] = make_pair(in[2 * i], in[2 * i + 1]);
+        N = (unsigned)in[2 * i] > N ? in[2 * i] : N;
+        N = (unsigned)in[2 * i + 1] > N ? in[2 * i + 1] : N;
+      }
+      sort(edge.begin(), edge.end());
+      edge.erase(unique(edge.begin(), edge.end()), edge.end());
 
       M = edge.size();
       color = new int[N + 1];
-      G = new vector<int>[N + 1];
-      for (auto e : edge) {
-        G[e.first].push_back(e.second);
-        G[e.second].push_back(e.first);
+      edges.resize(2 * M);
+      for (unsigned int i = 0; i < M; i++) {
+        edges[2 * i] = edge[i].first;
+        edges[2 * i + 1] = edge[i].second;
       }
     } else if (strcmp(format_name, "nde") == 0) {
       FILE *input_fd = fopen(input_graph, "r");
@@ -361,8 +349,6 @@ int main(int argc, char **argv) {
       }
 
       color = new int[N + 1];
-      G = new vector<int>[N + 1];
-
       int Mrim = M;
       while (Mrim > 0 && !feof(input_fd)) {
         free(buffer);
@@ -372,8 +358,8 @@ int main(int argc, char **argv) {
         if (line_length == 0) continue;
         if (buffer[0] == '#') continue;
         sscanf(buffer, "%d %d", ab, ab + 1);
-        G[ab[0]].push_back(ab[1]);
-        G[ab[1]].push_back(ab[0]);
+        edges.push_back(ab[0]);
+        edges.push_back(ab[1]);
       }
 
     } else if (strcmp(format_name, "nme") == 0) {
@@ -386,39 +372,34 @@ int main(int argc, char **argv) {
       read(input_fd, &M, sizeof(int));
 
       color = new int[N + 1];
-      G = new vector<int>[N + 1];
-      int ab[2];
-      for (unsigned int i = 0; i < M; i++) {
-        read(input_fd, ab, 2 * sizeof(int));
-        G[ab[0]].push_back(ab[1]);
-        G[ab[1]].push_back(ab[0]);
-      }
+      edges.resize(2 * M);
+      read(input_fd, edges.data(), 2 * M * sizeof(int));
     } else {
       printf("Wrong input format (only 'snap', 'nde' or 'nme'\n");
       return 1;
     }
   } else {
     // Read from stdin, nme format
-    N = nextInt();
-    M = nextInt();
+    vector<int> in;
+    if (!readTextInts(NULL, in) || in.size() < 2 ||
+        in.size() < 2 + 2 * (size_t)in[1]) {
+      printf("Error reading input graph\n");
+      return 1;
+    }
+    N = in[0];
+    M = in[1];
 
     color = new int[N + 1];
-    G = new vector<int>[N + 1];
-
-    for (unsigned int i = 0; i < M; i++) {
-      int a = nextInt();
-      int b = nextInt();
-      G[a].push_back(b);
-      G[b].push_back(a);
-    }
+    edges.assign(in.begin() + 2, in.begin() + 2 + 2 * M);
   }
 
   if (verbose_flag) printf("N = %d | M = %d\n", N, M);
 
   for (unsigned int i = 0; i < N; i++) {
-    G[N].push_back(i);
-    G[i].push_back(N);
+    edges.push_back(N);
+    edges.push_back(i);
   }
+  buildCSR(G, N + 1, edges);
 
   // Create DP Table
   for (unsigned int i = 0; i <= k + 1; i++)
@@ -4,6 +4,7 @@
   con la tecnica del color-coding
 */
 #include <bits/stdc++.h>
+#include "graph_read.hpp"
 
 using namespace std;
 typedef long long ll;
@@ -16,7 +17,7 @@ typedef long long ll;
 */
 unsigned int N, M, k, kp;
 int *color;
-vector<int> *G;
+CSRGraph G;
 
 inline int nextInt() {
   int r;
@@ -140,20 +141,15 @@ int main(int argc, char **argv) {
   kp = atol(argv[2]);
 
   color = new int[N + 1];
-  G = new vector<int>[N + 1];
-
-  for (unsigned int i = 0; i < M; i++) {
-    int a = nextInt();
-    int b = nextInt();
-    G[a].push_back(b);
-    G[b].push_back(a);
-  }
+  vector<int> ab(2 * M);
+  for (unsigned int i = 0; i < 2 * M; i++) ab[i] = nextInt();
 
   // Creo un nodo fittizio N che collegato a tutti nodi di G
   for (unsigned int i = 0; i < N; i++) {
-    G[N].push_back(i);
-    G[i].push_back(N);
+    ab.push_back(N);
+    ab.push_back(i);
   }
+  buildCSR(G, N + 1, ab);
 
   // Coloro il grafo casualmente
   randomColor();
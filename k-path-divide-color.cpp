@@ -4,12 +4,13 @@
   the divide-and-color technique
 */
 #include <bits/stdc++.h>
+#include "graph_read.hpp"
 
 using namespace std;
 typedef long long ll;
 
 int N, M, k, kp;
-set<int> *G;
+CSRGraph G;
 
 inline int nextInt() {
   int r;
@@ -44,7 +45,7 @@ set<pair<int, int> > list_k_path(unordered_set<int> Gp, int k) {
       {
         if( L1.find(make_pair(u,v)) == L1.end() ) continue;
         if( L2.find(make_pair(w,x)) == L2.end() ) continue;
-        if( G[v].find(w) == G[v].end() ) continue;
+        if( !G[v].contains(w) ) continue;
         ret.insert( make_pair(u, x) );
       }
       */
@@ -59,7 +60,7 @@ set<pair<int, int> > list_k_path(unordered_set<int> Gp, int k) {
           // Controllo se (u,w) € E
           int w = l2.first;
           int x = l2.second;
-          if (G[v].find(w) != G[v].end()) ret.insert(make_pair(u, x));
+          if (G[v].contains(w)) ret.insert(make_pair(u, x));
         }
       }
     }
@@ -77,14 +78,10 @@ int main(int argc, char **argv) {
   M = nextInt();
   k = atol(argv[1]);
 
-  G = new set<int>[N];
-
-  for (int i = 0; i < M; i++) {
-    int a = nextInt();
-    int b = nextInt();
-    G[a].insert(b);
-    G[b].insert(a);
-  }
+  vector<int> ab(2 * M);
+  for (int i = 0; i < 2 * M; i++) ab[i] = nextInt();
+  buildCSR(G, N, ab);
+  G.simplify();
 
   unordered_set<int> Gp;
   for (int i = 0; i < N; i++) Gp.insert(i);
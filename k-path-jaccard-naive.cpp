@@ -4,6 +4,7 @@
 */
 #include <algorithm>
 #include <vector>
+#include <string>
 #include <set>
 #include <map>
 #include <unordered_set>
@@ -15,6 +16,7 @@
 #include <omp.h>
 #include <getopt.h>
 #include <unistd.h>
+#include "graph_read.hpp"
 
 #ifdef K_8
   #define MAXK 8
@@ -40,7 +42,7 @@ static int verbose_flag, help_flag;
 
 ll cont = 0;
 char *label;
-vector<int> *G;
+CSRGraph G;
 int Sa, Sb;
 int *A, *B;
 set<int> setA, setB;
@@ -250,17 +252,14 @@ int main(int argc, char **argv) {
     for(unsigned int i=0; i<N; i++)
       label[i] = 'A' + intLabel[i];
 
-    G = new vector<int>[N + 1];
-    int ab[2];
-    for (unsigned int i = 0; i < M; i++) {
-      read(input_fd, ab, 2 * sizeof(int));
-      G[ab[0]].push_back(ab[1]);
-      G[ab[1]].push_back(ab[0]);
-    }
+    vector<int> ab(2 * M);
+    if (M > 0) read(input_fd, ab.data(), 2 * M * sizeof(int));
+    buildCSR(G, N, ab);
 
-    read(input_fd, ab, 2 * sizeof(int));
-    Sa = ab[0];
-    Sb = ab[1];
+    int S[2];
+    read(input_fd, S, 2 * sizeof(int));
+    Sa = S[0];
+    Sb = S[1];
     A = new int[Sa];
     B = new int[Sb];
 
@@ -274,17 +273,12 @@ int main(int argc, char **argv) {
     M = nextInt();
 
     label = new char[N + 1];
-    G = new vector<int>[N + 1];
-
     for(unsigned int i=0; i<N; i++)
       label[i] = 'A' + nextInt();
 
-    for (unsigned int i = 0; i < M; i++) {
-      int a = nextInt();
-      int b = nextInt();
-      G[a].push_back(b);
-      G[b].push_back(a);
-    }
+    vector<int> ab(2 * M);
+    for (unsigned int i = 0; i < 2 * M; i++) ab[i] = nextInt();
+    buildCSR(G, N, ab);
 
     Sa = nextInt();
     Sb = nextInt();
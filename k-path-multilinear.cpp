@@ -0,0 +1,201 @@
+/*
+  Author: Gaspare Ferraro
+  Find whether a graph has a simple k-path with algebraic multilinear
+  detection, or estimate their number with inclusion-exclusion color coding
+  (see multilinear.hpp): memory linear in the graph size, time
+  2^k * k * edges, no table exponential in k
+*/
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+#include <getopt.h>
+#include <sys/time.h>
+#include "graph_read.hpp"
+#include "multilinear.hpp"
+
+#define MAXK 32
+
+using namespace std;
+typedef long long ll;
+
+unsigned int N, M;
+unsigned int k = 0;
+unsigned int trials = 1;
+unsigned int seed = 42;
+unsigned thread_count = 0;
+static int verbose_flag, help_flag, ends_flag, count_flag;
+
+CSRGraph G;
+
+void print_usage(char *filename) {
+  printf(
+      "Usage: ./%s -k length -g filename -R trials -S seed -p threadcount "
+      "--ends --count --help --verbose\n",
+      filename);
+  printf("Valid arguments:\n");
+
+  printf("-k, --path length\n");
+  printf("\tNumber of nodes of the path (max %d).\n", MAXK);
+
+  printf("-g, --input filename\n");
+  printf("\tInput graph, CSR file (default stdin, \"N M\" then M edges)\n");
+
+  printf("-R, --trials number\n");
+  printf("\tIndependent evaluations, each one misses an existing path with\n");
+  printf("\tprobability at most (2k - 1) / 2^16 (default 1); with --count,\n");
+  printf("\tthe random colorings averaged\n");
+
+  printf("-S, --seed number\n");
+  printf("\tSeed of the random weights (default 42)\n");
+
+  printf("-p, --parallel threadcount\n");
+  printf("\tNumber of threads to use (default maximum thread avaiable)\n");
+
+  printf("--ends\n");
+  printf("\tCount the nodes ending a k-path (runs all the trials)\n");
+
+  printf("--count\n");
+  printf("\tEstimate the number of k-paths (node sequences, as k-path-naive)\n");
+
+  printf("--help\n");
+  printf("\tDisplay help text and exit.\n");
+
+  printf("--verbose\n");
+  printf("\tPrint status messages.\n");
+}
+
+char *input_graph = NULL;
+
+long long current_timestamp() {
+  struct timeval te;
+  gettimeofday(&te, NULL);
+  return te.tv_sec * 1000LL + te.tv_usec / 1000;
+}
+
+int main(int argc, char **argv) {
+  static struct option long_options[] = {
+      {"path", required_argument, 0, 'k'},
+      {"input", required_argument, 0, 'g'},
+      {"trials", required_argument, 0, 'R'},
+      {"seed", required_argument, 0, 'S'},
+      {"parallel", required_argument, 0, 'p'},
+      {"ends", no_argument, &ends_flag, 1},
+      {"count", no_argument, &count_flag, 1},
+      {"help", no_argument, &help_flag, 1},
+      {"verbose", no_argument, &verbose_flag, 1},
+      {0, 0, 0, 0}};
+
+  int option_index = 0;
+  int c;
+  while (1) {
+    c = getopt_long(argc, argv, "k:g:R:S:p:", long_options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 'k':
+        if (optarg != NULL) k = atoi(optarg);
+        break;
+      case 'g':
+        if (optarg != NULL) input_graph = optarg;
+        break;
+      case 'R':
+        if (optarg != NULL) trials = atoi(optarg);
+        break;
+      case 'S':
+        if (optarg != NULL) seed = atoi(optarg);
+        break;
+      case 'p':
+        if (optarg != NULL) thread_count = atoi(optarg);
+        break;
+    }
+  }
+
+  if (help_flag || argc == 1) {
+    print_usage(argv[0]);
+    return 0;
+  }
+
+  if (k == 0 || k > MAXK) {
+    printf("Invalid or missing path length value (max %d).\n", MAXK);
+    return 1;
+  }
+
+  if (thread_count > 0 && (int)thread_count < omp_get_max_threads()) {
+    omp_set_dynamic(0);
+    omp_set_num_threads(thread_count);
+  }
+
+  if (verbose_flag) {
+    printf("Options:\n");
+    printf("k = %d\n", k);
+    printf("R = %d\n", trials);
+    printf("S = %d\n", seed);
+    printf("thread = %d\n", thread_count);
+    printf("input_graph = %s\n", input_graph != NULL ? input_graph : "stdin");
+  }
+  if (verbose_flag) printf("Reading graph...\n");
+
+  if (input_graph != NULL) {
+    if (!isCSRFile(input_graph)) {
+      printf("%s is not a CSR graph file (see graph_convert)\n", input_graph);
+      return 1;
+    }
+    if (!mapCSR(input_graph, G, NULL, NULL)) return 1;
+    N = G.n;
+    M = G.arcs() / 2;
+  } else {
+    vector<int> in;
+    if (!readTextInts(NULL, in) || in.size() < 2 ||
+        in.size() < 2 + 2 * (size_t)in[1]) {
+      printf("Error reading input graph\n");
+      return 1;
+    }
+    N = in[0];
+    M = in[1];
+    buildCSR(G, N, in.data() + 2, M);
+  }
+  if (verbose_flag) printf("N = %d | M = %d\n", N, M);
+
+  if (count_flag) {
+    double sum = 0., sum2 = 0.;
+    ll time_a = current_timestamp();
+    for (unsigned int r = 0; r < trials; r++) {
+      double x = estimateKPaths(G, k, mlHash(seed + r));
+      if (verbose_flag) printf("Trial %u: %.6e\n", r + 1, x);
+      sum += x;
+      sum2 += x * x;
+    }
+    ll time_b = current_timestamp() - time_a;
+
+    double mean = sum / trials;
+    printf("k-paths: %.6e\n", mean);
+    if (trials > 1) {
+      double var = max(0., (sum2 - trials * mean * mean) / (trials - 1));
+      printf("Std. error: %.6e\n", sqrt(var / trials));
+    }
+    if (verbose_flag) printf("Time: %lld ms\n", time_b);
+    return 0;
+  }
+
+  vector<char> ends(N, 0);
+  bool found = false;
+  ll time_a = current_timestamp();
+  for (unsigned int r = 0; r < trials; r++) {
+    if (verbose_flag) printf("Trial %u...\n", r + 1);
+    found |= detectKPath(G, k, mlHash(seed + r), ends_flag ? &ends : NULL);
+    if (found && !ends_flag) break;
+  }
+  ll time_b = current_timestamp() - time_a;
+
+  printf("k-path: %s\n", found ? "found" : "not found");
+  if (ends_flag)
+    printf("End nodes: %zu\n", (size_t)count(ends.begin(), ends.end(), 1));
+  if (verbose_flag) printf("Time: %lld ms\n", time_b);
+  return 0;
+}
@@ -3,11 +3,12 @@
   Conta i k-path distinti in un grafo non orientato con una dfs
 */
 #include <bits/stdc++.h>
+#include "graph_read.hpp"
 
 using namespace std;
 
 int N, M, k;
-vector<int> *G;
+CSRGraph G;
 
 int nextInt() {
   int tmp;
@@ -49,15 +50,11 @@ int main(int argc, char **argv) {
   N = nextInt();
   M = nextInt();
 
-  G = new vector<int>[N];
   in = new bool[N];
 
-  for (int i = 0; i < M; i++) {
-    int a = nextInt();
-    int b = nextInt();
-    G[a].push_back(b);
-    G[b].push_back(a);
-  }
+  vector<int> ab(2 * M);
+  for (int i = 0; i < 2 * M; i++) ab[i] = nextInt();
+  buildCSR(G, N, ab);
 
   // Trovo i k-path a partire da ogni nodo
   for (int i = 0; i < N; i++) dfs(i);
@@ -0,0 +1,63 @@
+#ifndef _LABEL_TRIE_HPP
+#define _LABEL_TRIE_HPP
+
+#include <vector>
+#include <stdint.h>
+#include "qgram.hpp"
+
+// A set of path labels compiled into a trie with dense transitions: the
+// states are the prefixes of the labels, and the next state on a symbol is
+// one array lookup, next[state * sigma + symbol]. The symbols of the packed
+// labels are mapped to 0..sigma-1 (the distinct symbols in the labels), so
+// the table has sigma (the number of node labels) columns. The words may be
+// inserted reversed, to match paths read from their last node.
+class LabelTrie {
+  std::vector<int> symbol;     // label symbol -> column, -1 if in no label
+  unsigned int sigma;
+  std::vector<uint32_t> next;  // NONE if no label continues that way
+  std::vector<int> wordOf;     // index of the label ending in a state, or -1
+  std::vector<QGram> words;
+
+ public:
+  static const uint32_t NONE = ~(uint32_t)0;
+
+  // Trie of the labels W of length k, bits bits per symbol
+  LabelTrie(const QGramSet &W, unsigned int k, unsigned int bits, bool reversed)
+      : symbol((size_t)1 << bits, -1), sigma(0), words(W.begin(), W.end()) {
+    for (QGram w : words)
+      for (unsigned int j = 0; j < k; j++)
+        if (symbol[qgramAt(w, j, k, bits)] < 0) symbol[qgramAt(w, j, k, bits)] = sigma++;
+
+    next.assign(sigma, (uint32_t)NONE);
+    wordOf.assign(1, -1);
+    for (size_t i = 0; i < words.size(); i++) {
+      uint32_t s = root();
+      for (unsigned int j = 0; j < k; j++) {
+        int c = symbol[qgramAt(words[i], reversed ? k - 1 - j : j, k, bits)];
+        uint32_t &t = next[(size_t)s * sigma + c];
+        if (t == NONE) {
+          t = wordOf.size();
+          wordOf.push_back(-1);
+          next.resize(next.size() + sigma, (uint32_t)NONE);
+        }
+        s = next[(size_t)s * sigma + c];
+      }
+      wordOf[s] = i;
+    }
+  }
+
+  uint32_t root() const { return 0; }
+
+  // State after reading symbol a in state s; NONE if no label has that prefix
+  uint32_t step(uint32_t s, unsigned int a) const {
+    int c = symbol[a];
+    return c < 0 ? NONE : next[(size_t)s * sigma + c];
+  }
+
+  // Index of the label of state s (as given, not reversed), -1 if none
+  int word(uint32_t s) const { return wordOf[s]; }
+  size_t size() const { return words.size(); }
+  QGram label(int i) const { return words[i]; }
+};
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef _MULTILINEAR_HPP
+#define _MULTILINEAR_HPP
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "graph_read.hpp"
+#include "dp_schedule.hpp"
+
+// Algebraic k-path detection (multilinear detection, Koutis-Williams /
+// Bjorklund's labeled walks) in O(N) memory, alternative to the colorset DP
+// for large k. With a random weight f(u->v) for every arc and g(v, l) for
+// every node and label l in [k], the sum over the subsets T of [k] of
+//   sum over the walks v1..vk of prod f(v_i -> v_i+1) prod sum_{l in T} g(v_i, l)
+// is, in characteristic 2, the sum over the walks with a bijective labeling:
+// the labelings of walks visiting a node twice cancel out in pairs (swap the
+// labels of the first repeated node), the paths remain. As a polynomial it
+// is nonzero iff G has a k-path, so an evaluation over GF(2^16) is nonzero
+// with probability >= 1 - (2k - 1) / 2^16 if there is one, and always zero
+// otherwise. One evaluation is 2^k walk DPs with k levels each.
+//
+// The 2^k subsets are processed GF_LANES at a time, bit-sliced: the DP value
+// of a node is GF_LANES elements of GF(2^16), one per subset, stored as 16
+// planes of GF_LANES bits (GF_WORDS 64-bit words), so that every operation
+// works on all the subsets at once with word-wide (vectorizable) AND / XOR.
+#define GF_BITS 16
+#ifndef GF_WORDS
+#define GF_WORDS 4
+#endif
+#define GF_LANES (64 * GF_WORDS)
+
+// GF(2^16) modulo x^16 + x^5 + x^3 + x^2 + 1
+#define GF_POLY 0x002D
+
+// a * x
+inline uint16_t gfTimesX(uint16_t a) {
+  return (uint16_t)(a << 1) ^ ((a & 0x8000) ? GF_POLY : 0);
+}
+
+// GF_LANES elements of GF(2^16): bit t of plane j is bit j of element t
+struct GFSlice {
+  uint64_t p[GF_BITS][GF_WORDS];
+
+  void clear() { memset(p, 0, sizeof(p)); }
+
+  GFSlice &operator^=(const GFSlice &o) {
+    for (int j = 0; j < GF_BITS; j++)
+      for (int w = 0; w < GF_WORDS; w++) p[j][w] ^= o.p[j][w];
+    return *this;
+  }
+};
+
+// Multiplication by a constant c, as a GF(2)-linear map of the planes:
+// bit b of col[j] is set if plane b adds to plane j, i.e. bit j of c * x^b
+struct GFScalar {
+  uint16_t col[GF_BITS];
+};
+
+// The map is linear in c: the one of c is the sum of the maps of its low
+// and high byte, tabled (16 KB, cache resident)
+struct GFScalarTable {
+  GFScalar lo[256], hi[256];
+
+  static void map(GFScalar &s, uint16_t c) {
+    memset(&s, 0, sizeof(s));
+    for (int b = 0; b < GF_BITS; b++, c = gfTimesX(c))
+      for (int j = 0; j < GF_BITS; j++)
+        if ((c >> j) & 1) s.col[j] |= 1 << b;
+  }
+
+  GFScalarTable() {
+    for (int c = 0; c < 256; c++) {
+      map(lo[c], c);
+      map(hi[c], c << 8);
+    }
+  }
+};
+
+inline GFScalar gfScalar(uint16_t c) {
+  static GFScalarTable table;
+  GFScalar s;
+  const GFScalar &l = table.lo[c & 255], &h = table.hi[c >> 8];
+  for (int j = 0; j < GF_BITS; j++) s.col[j] = l.col[j] ^ h.col[j];
+  return s;
+}
+
+// r += c * x, c the same for every lane. Four Russians: the 16 sums of
+// every group of 4 planes of x are tabled, then every plane of r adds one
+// entry per group.
+inline void gfAddMulScalar(GFSlice &r, const GFSlice &x, const GFScalar &c) {
+  uint64_t t[GF_BITS / 4][16][GF_WORDS];
+  for (int g = 0; g < GF_BITS / 4; g++) {
+    for (int w = 0; w < GF_WORDS; w++) t[g][0][w] = 0;
+    for (int s = 1; s < 16; s++)
+      for (int w = 0; w < GF_WORDS; w++)
+        t[g][s][w] = t[g][s & (s - 1)][w] ^ x.p[4 * g + __builtin_ctz(s)][w];
+  }
+  for (int j = 0; j < GF_BITS; j++) {
+    unsigned int m = c.col[j];
+    for (int w = 0; w < GF_WORDS; w++)
+      r.p[j][w] ^= t[0][m & 15][w] ^ t[1][(m >> 4) & 15][w] ^
+                   t[2][(m >> 8) & 15][w] ^ t[3][m >> 12][w];
+  }
+}
+
+// r = x * y, lane by lane
+inline void gfMulSlice(GFSlice &r, const GFSlice &x, const GFSlice &y) {
+  uint64_t t[2 * GF_BITS - 1][GF_WORDS];
+  memset(t, 0, sizeof(t));
+  for (int a = 0; a < GF_BITS; a++)
+    for (int b = 0; b < GF_BITS; b++)
+      for (int w = 0; w < GF_WORDS; w++) t[a + b][w] ^= x.p[a][w] & y.p[b][w];
+
+  // x^16 = x^5 + x^3 + x^2 + 1, from the top
+  for (int d = 2 * GF_BITS - 2; d >= GF_BITS; d--)
+    for (int w = 0; w < GF_WORDS; w++) {
+      t[d - 16][w] ^= t[d][w];
+      t[d - 14][w] ^= t[d][w];
+      t[d - 13][w] ^= t[d][w];
+      t[d - 11][w] ^= t[d][w];
+    }
+  memcpy(r.p, t, sizeof(r.p));
+}
+
+// Sum of the lanes selected by mask
+inline uint16_t gfSumLanes(const GFSlice &x, const uint64_t *mask) {
+  uint16_t r = 0;
+  for (int j = 0; j < GF_BITS; j++) {
+    uint64_t s = 0;
+    for (int w = 0; w < GF_WORDS; w++) s ^= x.p[j][w] & mask[w];
+    r |= (uint16_t)__builtin_parityll(s) << j;
+  }
+  return r;
+}
+
+// Random weights of an evaluation, hashed from (seed, arc index) and
+// (seed, node, label) so that they take no memory. Arcs are weighted by
+// their index in the CSR: u -> v and v -> u differ, as required, and so do
+// repeated arcs, which would cancel out with the same weight.
+inline uint64_t mlHash(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+inline uint16_t mlArcWeight(uint64_t seed, uint64_t arc) {
+  return mlHash(seed ^ mlHash(arc));
+}
+
+inline uint16_t mlLabelWeight(uint64_t seed, int v, unsigned int l) {
+  return mlHash(~seed ^ mlHash(((uint64_t)(unsigned)v << 6) | l));
+}
+
+// One evaluation of the k-path polynomial of G (k nodes, k <= 32) with the
+// weights of seed. Returns true if it is nonzero, i.e. G has a k-path; if
+// ends != NULL, ends[v] is set to 1 for the nodes v found to end one.
+inline bool detectKPath(const CSRGraph &G, unsigned int k, uint64_t seed,
+                        std::vector<char> *ends = NULL) {
+  unsigned int n = G.n;
+  unsigned int laneBits = __builtin_ctz(GF_LANES);
+  unsigned int lowLabels = k < laneBits ? k : laneBits;
+
+  // Lanes of the subsets containing label l < laneBits, and the valid lanes
+  // (subsets of [k]) if k < laneBits
+  uint64_t labelMask[32][GF_WORDS], valid[GF_WORDS];
+  for (unsigned int l = 0; l < lowLabels; l++)
+    for (int w = 0; w < GF_WORDS; w++) {
+      uint64_t m = 0;
+      for (int b = 0; b < 64; b++)
+        if (((64 * w + b) >> l) & 1) m |= 1ull << b;
+      labelMask[l][w] = m;
+    }
+  for (int w = 0; w < GF_WORDS; w++) {
+    uint64_t m = 0;
+    for (int b = 0; b < 64; b++)
+      if (k >= laneBits || 64 * w + b < (1 << k)) m |= 1ull << b;
+    valid[w] = m;
+  }
+
+  // Label sums of v: lane t of batch holds sum_{l in T} g(v, l), with T the
+  // subset batch * GF_LANES + t
+  auto labelSums = [&](GFSlice &s, int v, uint64_t batch) {
+    uint16_t high = 0;
+    for (unsigned int l = laneBits; l < k; l++)
+      if ((batch >> (l - laneBits)) & 1) high ^= mlLabelWeight(seed, v, l);
+    for (int j = 0; j < GF_BITS; j++)
+      for (int w = 0; w < GF_WORDS; w++)
+        s.p[j][w] = ((high >> j) & 1) ? ~0ull : 0ull;
+    for (unsigned int l = 0; l < lowLabels; l++) {
+      uint16_t g = mlLabelWeight(seed, v, l);
+      for (; g != 0; g &= g - 1) {
+        int j = __builtin_ctz(g);
+        for (int w = 0; w < GF_WORDS; w++) s.p[j][w] ^= labelMask[l][w];
+      }
+    }
+  };
+
+  DPSchedule S = makeSchedule(G, n, [](int) { return (uint64_t)1; });
+  std::vector<GFSlice> cur(n), next(n), part(S.parts());
+  std::vector<uint16_t> endSum(n, 0);
+  uint64_t batches = k > laneBits ? 1ull << (k - laneBits) : 1;
+
+  for (uint64_t batch = 0; batch < batches; batch++) {
+    #pragma omp parallel for schedule(guided)
+    for (unsigned int v = 0; v < n; v++) labelSums(cur[v], v, batch);
+
+    for (unsigned int i = 2; i <= k; i++) {
+      // next(v) = g_T(v) * sum_{arcs j = (v, u)} f(j) cur(u)
+      #pragma omp parallel
+      {
+        GFSlice s, g;
+
+        #pragma omp for schedule(runtime)
+        for (size_t t = 0; t < S.tasks.size(); t++) {
+          const DPTask &T = S.tasks[t];
+          if (T.part >= 0) {
+            part[T.part].clear();
+            for (uint64_t j = T.b; j < T.e; j++)
+              gfAddMulScalar(part[T.part], cur[G.adj[j]], gfScalar(mlArcWeight(seed, j)));
+            continue;
+          }
+          for (unsigned int v = T.u; v < T.uEnd; v++) {
+            s.clear();
+            for (uint64_t j = G.off[v]; j < G.end[v]; j++)
+              gfAddMulScalar(s, cur[G.adj[j]], gfScalar(mlArcWeight(seed, j)));
+            labelSums(g, v, batch);
+            gfMulSlice(next[v], s, g);
+          }
+        }
+
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t h = 0; h < S.hubs.size(); h++) {
+          s.clear();
+          for (size_t p = S.hubParts[h]; p < S.hubParts[h + 1]; p++) s ^= part[p];
+          labelSums(g, S.hubs[h], batch);
+          gfMulSlice(next[S.hubs[h]], s, g);
+        }
+      }
+      cur.swap(next);
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (unsigned int v = 0; v < n; v++) endSum[v] ^= gfSumLanes(cur[v], valid);
+  }
+
+  bool found = false;
+  for (unsigned int v = 0; v < n; v++) {
+    if (endSum[v] == 0) continue;
+    found = true;
+    if (ends != NULL) (*ends)[v] = 1;
+  }
+  return found;
+}
+
+// Approximate k-path counting, by color coding with inclusion-exclusion
+// (Koutis, Amini-Fomin-Saurabh) in the same O(N) memory. With the nodes
+// colored at random in k colors, the k-walks with k distinct colors are the
+// colorful k-paths, and their number is
+//   sum over the subsets T of [k] of (-1)^(k - |T|) walks(T),
+// walks(T) the k-walks on the nodes with color in T: k levels of one counter
+// per node. The counts are mod 2^64, exact unless the colorful paths are
+// more. A k-path is colorful with probability k! / k^k, so colorful * k^k /
+// k! estimates the k-paths without bias. The subsets go ML_LANES at a time,
+// one counter per subset in every node, so that the sums vectorize.
+#define ML_LANES 8
+
+// Counters of ML_LANES subsets
+struct MLCounts {
+  uint64_t c[ML_LANES];
+
+  void clear() {
+    for (int l = 0; l < ML_LANES; l++) c[l] = 0;
+  }
+  MLCounts &operator+=(const MLCounts &o) {
+    for (int l = 0; l < ML_LANES; l++) c[l] += o.c[l];
+    return *this;
+  }
+};
+
+// Color of v in the coloring of seed
+inline unsigned int mlColor(uint64_t seed, int v, unsigned int k) {
+  return mlHash(seed ^ mlHash(~(uint64_t)(unsigned)v)) % k;
+}
+
+// Number of colorful k-paths of G (k <= 32, node sequences: a path of k > 1
+// nodes counts once per direction) with the coloring of seed
+inline uint64_t countColorfulPaths(const CSRGraph &G, unsigned int k, uint64_t seed) {
+  unsigned int n = G.n;
+  std::vector<unsigned int> color(n);
+  for (unsigned int v = 0; v < n; v++) color[v] = mlColor(seed, v, k);
+
+  DPSchedule S = makeSchedule(G, n, [](int) { return (uint64_t)1; });
+  std::vector<MLCounts> cur(n), next(n), part(S.parts());
+  uint64_t subsets = 1ull << k, total = 0;
+
+  for (uint64_t T0 = 0; T0 < subsets; T0 += ML_LANES) {
+    // r = s on the subsets T0 + l containing the color of v, 0 elsewhere
+    auto mask = [&](MLCounts &r, const MLCounts &s, unsigned int v) {
+      for (int l = 0; l < ML_LANES; l++)
+        r.c[l] = T0 + l < subsets && ((T0 + l) >> color[v]) & 1 ? s.c[l] : 0;
+    };
+    MLCounts one;
+    for (int l = 0; l < ML_LANES; l++) one.c[l] = 1;
+
+    #pragma omp parallel for schedule(guided)
+    for (unsigned int v = 0; v < n; v++) mask(cur[v], one, v);
+
+    for (unsigned int i = 2; i <= k; i++) {
+      // next(v) = [color(v) in T] * sum_{u in G[v]} cur(u)
+      #pragma omp parallel
+      {
+        MLCounts s;
+
+        #pragma omp for schedule(runtime)
+        for (size_t t = 0; t < S.tasks.size(); t++) {
+          const DPTask &T = S.tasks[t];
+          if (T.part >= 0) {
+            part[T.part].clear();
+            for (uint64_t j = T.b; j < T.e; j++) part[T.part] += cur[G.adj[j]];
+            continue;
+          }
+          for (unsigned int v = T.u; v < T.uEnd; v++) {
+            s.clear();
+            for (int u : G[v]) s += cur[u];
+            mask(next[v], s, v);
+          }
+        }
+
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t h = 0; h < S.hubs.size(); h++) {
+          s.clear();
+          for (size_t p = S.hubParts[h]; p < S.hubParts[h + 1]; p++) s += part[p];
+          mask(next[S.hubs[h]], s, S.hubs[h]);
+        }
+      }
+      cur.swap(next);
+    }
+
+    MLCounts walks;
+    walks.clear();
+    for (unsigned int v = 0; v < n; v++) walks += cur[v];
+    for (int l = 0; l < ML_LANES && T0 + l < subsets; l++) {
+      bool odd = (k - __builtin_popcountll(T0 + l)) & 1;
+      total += odd ? -walks.c[l] : walks.c[l];
+    }
+  }
+  return total;
+}
+
+// Estimate of the number of k-paths of G (node sequences, as above) from
+// the colorful ones in the coloring of seed
+inline double estimateKPaths(const CSRGraph &G, unsigned int k, uint64_t seed) {
+  double scale = 1.;  // k^k / k!
+  for (unsigned int i = 1; i <= k; i++) scale *= (double)k / i;
+  return scale * (double)countColorfulPaths(G, k, seed);
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef _NUMA_PLACE_HPP
+#define _NUMA_PLACE_HPP
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "graph_read.hpp"
+#include "dp_schedule.hpp"
+
+// NUMA-aware placement of the DP, without libnuma: the topology comes from
+// sysfs, the threads are pinned with sched_setaffinity, and the memory is
+// placed by first touch (the default Linux policy): the graph slice and the
+// DP rows of the nodes a thread processes are written first by that thread.
+// The DP then runs its tasks statically (see dpPlacement()).
+
+// CPUs of every NUMA node (a single node with all the CPUs if sysfs has no
+// NUMA information)
+struct NumaTopology {
+  std::vector<std::vector<int>> cpus;
+
+  int nodes() const { return cpus.size(); }
+};
+
+// Parse a sysfs CPU list ("0-3,8-11")
+inline std::vector<int> parseCPUList(const char *s) {
+  std::vector<int> cpus;
+  while (*s != '\0' && *s != '\n') {
+    char *e;
+    int a = strtol(s, &e, 10), b = a;
+    if (e == s) break;
+    if (*e == '-') {
+      s = e + 1;
+      b = strtol(s, &e, 10);
+    }
+    for (int c = a; c <= b; c++) cpus.push_back(c);
+    s = *e == ',' ? e + 1 : e;
+  }
+  return cpus;
+}
+
+inline NumaTopology numaTopology() {
+  NumaTopology T;
+  for (int node = 0;; node++) {
+    char path[64], line[4096];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) break;
+    if (fgets(line, sizeof(line), f) != NULL) T.cpus.push_back(parseCPUList(line));
+    fclose(f);
+  }
+  if (T.cpus.empty()) {
+    cpu_set_t set;
+    T.cpus.resize(1);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+      for (int c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &set)) T.cpus[0].push_back(c);
+  }
+  return T;
+}
+
+// Pin the OpenMP threads to the allowed CPUs taken in node order, so that
+// consecutive threads (which run consecutive ranges of nodes) share a NUMA
+// node. Returns the node of every thread. Needs omp_set_dynamic(0).
+inline std::vector<int> numaPinThreads(const NumaTopology &T) {
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) CPU_ZERO(&allowed);
+  std::vector<int> cpus, cpuNode;
+  for (int node = 0; node < T.nodes(); node++)
+    for (int c : T.cpus[node])
+      if (c < CPU_SETSIZE && CPU_ISSET(c, &allowed)) {
+        cpus.push_back(c);
+        cpuNode.push_back(node);
+      }
+
+  int threads = csrThreads();
+  std::vector<int> threadNode(threads, 0);
+  if (cpus.empty()) return threadNode;
+
+  #pragma omp parallel num_threads(threads)
+  {
+    int t = 0;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#endif
+    size_t k = (size_t)t * cpus.size() / threads;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[k], &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) perror("Error pinning thread");
+    threadNode[t] = cpuNode[k];
+  }
+  return threadNode;
+}
+
+// Memory placed by first touch: anonymous pages are allocated when written
+// first, on the node of the writing thread. Never freed, like a mapped file:
+// for the arrays allocated once per process (the graph, the dense DP).
+template <typename T>
+T *numaAlloc(size_t count) {
+  size_t bytes = count > 0 ? count * sizeof(T) : 1;
+  void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) throw std::bad_alloc();
+  return (T *)p;
+}
+
+// Placed arrays of a structure rebuilt or replaced during the run (the DP
+// layers): unmapped when the last copy of their owner is cleared
+typedef std::vector<std::shared_ptr<void>> NumaMemory;
+
+template <typename T>
+T *numaAlloc(size_t count, NumaMemory &owner) {
+  size_t bytes = count > 0 ? count * sizeof(T) : 1;
+  T *p = numaAlloc<T>(count);
+  owner.push_back(std::shared_ptr<void>(p, [bytes](void *q) { munmap(q, bytes); }));
+  return p;
+}
+
+// Node of the calling thread
+inline int numaNodeOf(const std::vector<int> &threadNode) {
+#ifdef _OPENMP
+  return threadNode[omp_get_thread_num()];
+#else
+  return threadNode[0];
+#endif
+}
+
+// Move G (compact) to placed memory: every thread copies the slice of the nodes it
+// processes in the DP (the schedule of makeSchedule() with dpPlacement()).
+// nodeOf[u] is the NUMA node of the thread processing u. Done once per
+// process: the placed arrays are kept even after updateCSR copies them.
+inline void numaPlaceCSR(CSRGraph &G, const std::vector<int> &threadNode,
+                         std::vector<int> &nodeOf) {
+  unsigned int n = G.n;
+  DPSchedule S = makeSchedule(G, n, [](int) { return (uint64_t)1; });
+  uint64_t *off = numaAlloc<uint64_t>(n + 1);
+  int *adj = numaAlloc<int>(G.m);
+  nodeOf.assign(n, 0);
+
+  #pragma omp parallel for schedule(runtime)
+  for (size_t t = 0; t < S.tasks.size(); t++) {
+    const DPTask &T = S.tasks[t];
+    uint64_t b = T.part >= 0 ? T.b : G.off[T.u];
+    uint64_t e = T.part >= 0 ? T.e : G.off[T.uEnd];
+    memcpy(adj + b, G.adj + b, (e - b) * sizeof(int));
+    if (T.part >= 0 && T.b != G.off[T.u]) continue;
+    for (unsigned int u = T.u; u < T.uEnd; u++) {
+      off[u] = G.off[u];
+      nodeOf[u] = numaNodeOf(threadNode);
+    }
+  }
+  off[n] = G.off[n];
+
+  std::vector<uint64_t>().swap(G.offData);
+  std::vector<int>().swap(G.adjData);
+  G.off = off;
+  G.end = off + 1;
+  G.adj = adj;
+}
+
+// Traffic of the DP per NUMA node: bytes of the neighbour rows read by the
+// threads of the node, from rows on the same node or on another one
+struct NumaCounters {
+  std::vector<uint64_t> local, remote;
+
+  NumaCounters(int nodes) : local(nodes, 0), remote(nodes, 0) {}
+
+  // A level read from the previous one, whose row of u takes bytes(u)
+  template <typename RowBytes>
+  void addLevel(const CSRGraph &G, const std::vector<int> &nodeOf,
+                RowBytes bytes) {
+    for (unsigned int v = 0; v < G.n; v++)
+      for (int u : G[v]) {
+        if (nodeOf[u] == nodeOf[v])
+          local[nodeOf[v]] += bytes(u);
+        else
+          remote[nodeOf[v]] += bytes(u);
+      }
+  }
+
+  // Traffic and bandwidth of every node over seconds
+  void print(double seconds) const {
+    for (size_t node = 0; node < local.size(); node++) {
+      double l = local[node] / 1e9, r = remote[node] / 1e9;
+      printf("NUMA node %zu: local %.3f GB | remote %.3f GB | %.2f GB/s\n",
+             node, l, r, seconds > 0 ? (l + r) / seconds : 0.0);
+    }
+  }
+};
+
+#endif
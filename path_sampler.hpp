@@ -0,0 +1,106 @@
+#ifndef _PATH_SAMPLER_HPP
+#define _PATH_SAMPLER_HPP
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <unordered_map>
+#include <stdint.h>
+#include "graph_read.hpp"
+
+// Neighbour sampling of randomPathTo. A step of a random path from u draws
+// a neighbour v with probability proportional to weight(v), its DP count
+// for the colors (or filter) still free. The step depends only on (level,
+// u, colors free): its neighbours of non-zero weight and their cumulative
+// weights are built on first use and cached, and every later draw of the
+// same step is one binary search, with no allocation and no DP lookup.
+
+// A step: next[j] is drawn with probability (cum[j] - cum[j - 1]) / cum.back()
+struct PathStep {
+  std::vector<int> next;
+  std::vector<uint64_t> cum;
+
+  // Draw a neighbour; -1 if all the weights are zero
+  template <typename Rng>
+  int sample(Rng &eng) const {
+    if (cum.empty()) return -1;
+    uint64_t r = std::uniform_int_distribution<uint64_t>(0, cum.back() - 1)(eng);
+    return next[std::upper_bound(cum.begin(), cum.end(), r) - cum.begin()];
+  }
+};
+
+// A draw of an index of w, with probability proportional to w[j]
+template <typename W>
+PathStep weightedChoice(const std::vector<W> &w) {
+  PathStep S;
+  uint64_t sum = 0;
+  for (size_t j = 0; j < w.size(); j++) {
+    if (w[j] == 0) continue;
+    sum += w[j];
+    S.next.push_back(j);
+    S.cum.push_back(sum);
+  }
+  return S;
+}
+
+// Cache of the steps, keyed by (level, node, set). Not thread safe: use one
+// per thread to sample in parallel. A long run (--serve) visits ever more
+// steps: the cache is emptied when it holds more than limit neighbours (a
+// step counting as its neighbours plus 8 for the map node), and the steps
+// are built again on use.
+class PathSampler {
+  struct Key {
+    uint64_t node;  // level << 32 | node
+    uint64_t set;
+
+    bool operator==(const Key &o) const { return node == o.node && set == o.set; }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &k) const {
+      uint64_t h = (k.node * 0x9e3779b97f4a7c15ull) ^ k.set;
+      h = (h ^ (h >> 31)) * 0xbf58476d1ce4e5b9ull;
+      return h ^ (h >> 29);
+    }
+  };
+
+  std::unordered_map<Key, PathStep, KeyHash> steps;
+  size_t entries, limit;
+
+ public:
+  PathSampler(size_t limit = 1 << 22) : entries(0), limit(limit) {}
+
+
+  // The step from u at level (any id below 2^32, e.g. coloring and level)
+  // with the colorset set free, weight(v) the weight of the neighbour v
+  template <typename Weight>
+  const PathStep &step(const CSRGraph &G, uint64_t level, int u, uint64_t set,
+                       Weight weight) {
+    Key key = {level << 32 | (uint32_t)u, set};
+    auto it = steps.find(key);
+    if (it != steps.end()) return it->second;
+    if (entries >= limit) clear();
+
+    PathStep &S = steps[key];
+    uint64_t sum = 0;
+    for (int v : G[u]) {
+      uint64_t w = weight(v);
+      if (w == 0) continue;
+      sum += w;
+      S.next.push_back(v);
+      S.cum.push_back(sum);
+    }
+    entries += S.next.size() + 8;
+    return S;
+  }
+
+  size_t size() const { return steps.size(); }
+
+  // Drop the cached steps (the DP table changed, or the cache is full)
+  void clear() {
+    steps.clear();
+    entries = 0;
+  }
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef _PATH_SET_HPP
+#define _PATH_SET_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// Deduplication of the sampled paths by fingerprint, instead of sets of
+// node vectors: a path is identified by a 128-bit hash of its nodes, built
+// while it is sampled, and only the paths found new are kept. Two distinct
+// paths share a fingerprint with probability ~ 2^-128 per pair.
+
+// Fingerprint of a node sequence, extended one node at a time: two 64-bit
+// hashes with independent mixing
+struct PathFingerprint {
+  uint64_t a, b;
+
+  PathFingerprint() : a(0x243f6a8885a308d3ull), b(0x13198a2e03707344ull) {}
+
+  static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  void add(int v) {
+    a = mix(a ^ (uint32_t)v);
+    b = mix(b + (uint32_t)v * 0x9e3779b97f4a7c15ull);
+  }
+};
+
+inline PathFingerprint pathFingerprint(const std::vector<int> &P) {
+  PathFingerprint f;
+  for (int v : P) f.add(v);
+  return f;
+}
+
+// Set of fingerprints: open addressing with linear probing, two words per
+// slot. insert() is lock-free and may run on many threads at once; the
+// table grows only in reserve(), between parallel phases.
+class PathSet {
+  std::unique_ptr<std::atomic<uint64_t>[]> slots;
+  size_t mask = 0;
+  std::atomic<size_t> count;
+
+  // Words are never 0 (the empty slot)
+  static uint64_t word(uint64_t x) { return x | 1; }
+
+  bool put(uint64_t a, uint64_t b) {
+    for (size_t i = a >> 1 & mask;; i = (i + 1) & mask) {
+      uint64_t cur = slots[2 * i].load(std::memory_order_acquire);
+      if (cur == 0) {
+        if (slots[2 * i].compare_exchange_strong(cur, a, std::memory_order_acq_rel)) {
+          slots[2 * i + 1].store(b, std::memory_order_release);
+          count++;
+          return true;
+        }
+        // cur is now the word of the winner
+      }
+      if (cur != a) continue;
+      uint64_t other;
+      while ((other = slots[2 * i + 1].load(std::memory_order_acquire)) == 0) {
+      }
+      if (other == b) return false;
+    }
+  }
+
+ public:
+  PathSet() : count(0) {}
+
+  size_t size() const { return count; }
+
+  // Room for n more fingerprints, load at most 1/2
+  void reserve(size_t n) {
+    size_t need = 2 * (count + n), cap = mask + 1;
+    if (slots && cap >= need) return;
+    for (cap = 16; cap < need; cap *= 2) {
+    }
+    std::unique_ptr<std::atomic<uint64_t>[]> old(std::move(slots));
+    size_t oldCap = old ? mask + 1 : 0;
+    slots.reset(new std::atomic<uint64_t>[2 * cap]);
+    for (size_t i = 0; i < 2 * cap; i++) slots[i].store(0, std::memory_order_relaxed);
+    mask = cap - 1;
+    count = 0;
+    for (size_t i = 0; i < oldCap; i++) {
+      uint64_t a = old[2 * i].load(std::memory_order_relaxed);
+      if (a != 0) put(a, old[2 * i + 1].load(std::memory_order_relaxed));
+    }
+  }
+
+  // Add f; true if it was not in the set. Needs room (reserve()).
+  bool insert(const PathFingerprint &f) { return put(word(f.a), word(f.b)); }
+};
+
+#endif
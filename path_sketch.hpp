@@ -0,0 +1,107 @@
+#ifndef _PATH_SKETCH_HPP
+#define _PATH_SKETCH_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <stddef.h>
+#include <stdint.h>
+#include "qgram.hpp"
+
+// Index of the q-path label distributions of all the nodes, for top-k
+// similarity search. Every node is summarized by a weighted MinHash sketch
+// of the labels of its sampled paths: a label seen c times is the c
+// elements (label, 1) .. (label, c), and the sketch holds the min of k
+// hashes over the elements. Two sketches agree in a position with
+// probability the weighted Jaccard of the label counts, sum of min / sum of
+// max. The queries do not scan all the nodes: the sketches are cut in bands
+// of k / bands hashes, and only the nodes sharing a band with the query
+// (LSH banding) are compared.
+class SketchIndex {
+  unsigned int k, bands;
+  std::vector<uint64_t> mins;  // k per node
+  std::vector<char> sketched;  // the node has paths
+  std::vector<std::unordered_map<uint64_t, std::vector<int>>> buckets;  // per band
+
+  static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  uint64_t bandKey(int u, unsigned int b) const {
+    unsigned int rows = k / bands;
+    uint64_t h = 0;
+    for (unsigned int r = 0; r < rows; r++)
+      h = mix(h ^ mins[(size_t)u * k + b * rows + r]);
+    return h;
+  }
+
+ public:
+  // Index of n nodes, sketches of k hashes in bands bands (k % bands == 0)
+  SketchIndex(size_t n, unsigned int k, unsigned int bands)
+      : k(k), bands(bands), mins(n * k, ~0ull), sketched(n, 0), buckets(bands) {}
+
+  size_t size() const { return sketched.size(); }
+  bool has(int u) const { return sketched[u]; }
+
+  // Sketch of node u from the labels of its sampled paths. Nodes may be
+  // sketched in parallel, build() after all of them.
+  void add(int u, const std::vector<QGram> &labels) {
+    std::unordered_map<QGram, uint64_t, QGramHash> count;
+    for (QGram l : labels) count[l]++;
+    uint64_t *m = &mins[(size_t)u * k];
+    for (auto &w : count) {
+      uint64_t h = mix(QGramHash()(w.first) ^ 0xcbf29ce484222325ull);
+      for (uint64_t j = 1; j <= w.second; j++) {
+        uint64_t e = mix(h + j * 0x9e3779b97f4a7c15ull);
+        for (unsigned int i = 0; i < k; i++)
+          m[i] = std::min(m[i], mix(e ^ (i + 1) * 0xd6e8feb86659fd93ull));
+      }
+    }
+    sketched[u] = !count.empty();
+  }
+
+  // Fill the LSH buckets
+  void build() {
+    for (unsigned int b = 0; b < bands; b++) {
+      buckets[b].clear();
+      for (size_t u = 0; u < size(); u++)
+        if (sketched[u]) buckets[b][bandKey(u, b)].push_back(u);
+    }
+  }
+
+  // Estimated weighted Jaccard of the labels of u and v
+  double similarity(int u, int v) const {
+    if (!sketched[u] || !sketched[v]) return 0;
+    unsigned int same = 0;
+    for (unsigned int i = 0; i < k; i++)
+      same += mins[(size_t)u * k + i] == mins[(size_t)v * k + i];
+    return (double)same / k;
+  }
+
+  // The t nodes most similar to u among the nodes sharing a band with it,
+  // by decreasing similarity (fewer if there are fewer candidates)
+  std::vector<std::pair<int, double>> top(int u, size_t t) const {
+    std::vector<std::pair<int, double>> best;
+    if (!sketched[u]) return best;
+    std::vector<int> cand;
+    for (unsigned int b = 0; b < bands; b++) {
+      auto it = buckets[b].find(bandKey(u, b));
+      if (it != buckets[b].end()) cand.insert(cand.end(), it->second.begin(), it->second.end());
+    }
+    std::sort(cand.begin(), cand.end());
+    cand.erase(std::unique(cand.begin(), cand.end()), cand.end());
+    for (int v : cand)
+      if (v != u) best.push_back(std::make_pair(v, similarity(u, v)));
+    std::sort(best.begin(), best.end(),
+              [](const std::pair<int, double> &a, const std::pair<int, double> &b) {
+                return a.second != b.second ? a.second > b.second : a.first < b.first;
+              });
+    if (best.size() > t) best.resize(t);
+    return best;
+  }
+};
+
+#endif
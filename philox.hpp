@@ -0,0 +1,64 @@
+#ifndef _PHILOX_HPP
+#define _PHILOX_HPP
+
+#include <stdint.h>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3", SC 2011). The output is a bijective hash of
+// (key, counter): the stream of Philox(seed, stream) depends on nothing
+// else, so that the random draws of every sample can be made on any thread,
+// in any order, with no shared state. Usable with the <random>
+// distributions (UniformRandomBitGenerator of 64-bit values).
+class Philox {
+  uint32_t key[2];
+  uint64_t stream, ctr;
+  uint64_t out[2];
+  int left;
+
+  static void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo) {
+    uint64_t p = (uint64_t)a * b;
+    hi = p >> 32;
+    lo = (uint32_t)p;
+  }
+
+  // 128 random bits from the block (ctr, stream)
+  void block() {
+    uint32_t c[4] = {(uint32_t)ctr, (uint32_t)(ctr >> 32), (uint32_t)stream,
+                     (uint32_t)(stream >> 32)};
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int r = 0; r < 10; r++) {
+      uint32_t hi0, lo0, hi1, lo1;
+      mulhilo(0xD2511F53u, c[0], hi0, lo0);
+      mulhilo(0xCD9E8D57u, c[2], hi1, lo1);
+      uint32_t n0 = hi1 ^ c[1] ^ k0, n2 = hi0 ^ c[3] ^ k1;
+      c[0] = n0;
+      c[1] = lo1;
+      c[2] = n2;
+      c[3] = lo0;
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+    out[0] = (uint64_t)c[1] << 32 | c[0];
+    out[1] = (uint64_t)c[3] << 32 | c[2];
+    ctr++;
+    left = 2;
+  }
+
+ public:
+  typedef uint64_t result_type;
+
+  Philox(uint64_t seed, uint64_t stream) : stream(stream), ctr(0), left(0) {
+    key[0] = (uint32_t)seed;
+    key[1] = (uint32_t)(seed >> 32);
+  }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return ~(result_type)0; }
+
+  result_type operator()() {
+    if (left == 0) block();
+    return out[2 - left--];
+  }
+};
+
+#endif
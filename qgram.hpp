@@ -0,0 +1,101 @@
+#ifndef _QGRAM_HPP
+#define _QGRAM_HPP
+
+#include <string>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
+#include <stddef.h>
+#include <stdint.h>
+
+// Path labels packed in an integer: the node labels are the symbols
+// 0..sigma-1, bits bits each, the first node of the path in the high bits.
+// All the labels compared are of the same length q, so it is not stored.
+// A q-path label fits if q * bits <= 128 (32 nodes of up to 16 labels, 16
+// of up to 256); with QGRAM_64 the labels are 64 bits, faster to hash and
+// compare, and fit if q * bits <= 64.
+#ifdef QGRAM_64
+typedef uint64_t QGram;
+#else
+__extension__ typedef unsigned __int128 QGram;
+#endif
+
+// Bits per symbol for sigma symbols (at least 1)
+inline unsigned int qgramBits(unsigned int sigma) {
+  unsigned int bits = 1;
+  while (bits < 32 && (1u << bits) < sigma) bits++;
+  return bits;
+}
+
+// Bits per symbol for the node labels l[0..n-1], the symbols l[i] - base
+inline unsigned int qgramBits(const char *l, size_t n, char base) {
+  unsigned int sigma = 1;
+  for (size_t i = 0; i < n; i++) {
+    unsigned int a = (unsigned char)(l[i] - base);
+    if (a + 1 > sigma) sigma = a + 1;
+  }
+  return qgramBits(sigma);
+}
+
+// Label g followed by symbol s
+inline QGram qgramPush(QGram g, unsigned int s, unsigned int bits) {
+  return g << bits | s;
+}
+
+// Label g without its last symbol
+inline QGram qgramPop(QGram g, unsigned int bits) { return g >> bits; }
+
+// Symbol i of the label g of length k
+inline unsigned int qgramAt(QGram g, size_t i, size_t k, unsigned int bits) {
+  return (unsigned int)(g >> (k - 1 - i) * bits) & ((1u << bits) - 1);
+}
+
+// The label of the characters of s (symbols s[i] - base); false if a symbol
+// takes more than bits bits
+inline bool qgramOf(const std::string &s, unsigned int bits, char base, QGram &g) {
+  g = 0;
+  for (char ch : s) {
+    unsigned int a = (unsigned char)(ch - base);
+    if (a >> bits) return false;
+    g = qgramPush(g, a, bits);
+  }
+  return true;
+}
+
+// The characters of the label g of length k (symbols + base)
+inline std::string qgramString(QGram g, size_t k, unsigned int bits, char base) {
+  std::string s(k, base);
+  for (size_t i = 0; i < k; i++) s[i] = base + qgramAt(g, i, k, bits);
+  return s;
+}
+
+// Hash of the labels (and of the start node and label of a path), mixing
+// all the symbols into all the bits
+struct QGramHash {
+  static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+  size_t operator()(QGram g) const {
+    return mix((uint64_t)g ^ mix((uint64_t)(g >> 32 >> 32)));
+  }
+  // a label and a node or a colorset
+  template <typename T>
+  size_t operator()(const std::pair<T, QGram> &p) const {
+    return mix((*this)(p.second) ^ (uint64_t)p.first);
+  }
+};
+
+typedef std::unordered_set<QGram, QGramHash> QGramSet;
+typedef std::unordered_map<QGram, long long, QGramHash> QGramCount;
+// Paths by start node and label
+typedef std::unordered_map<std::pair<int, QGram>, long long, QGramHash> StartQGramCount;
+
+// Count of label x, 0 if not counted
+inline long long qgramCount(const QGramCount &freq, QGram x) {
+  QGramCount::const_iterator it = freq.find(x);
+  return it == freq.end() ? 0 : it->second;
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef _QUERY_SERVER_HPP
+#define _QUERY_SERVER_HPP
+
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Line-oriented query server, for the programs that keep the graph and the
+// DP table in memory between queries. Every line is a query, answered by
+// one line. The lines that arrive together (in one read, from one or more
+// clients) are a batch: they are answered in order and the answers written
+// at once. The line "quit" stops the server.
+
+// Write all of s to fd
+inline bool writeAll(int fd, const std::string &s) {
+  size_t done = 0;
+  while (done < s.size()) {
+    ssize_t n = write(fd, s.data() + done, s.size() - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    done += n;
+  }
+  return true;
+}
+
+// Read what is available on fd into buf; false at the end of the input,
+// when the last line (which may have no newline) is completed
+inline bool readChunk(int fd, std::string &buf) {
+  char chunk[1 << 16];
+  ssize_t n;
+  do
+    n = read(fd, chunk, sizeof(chunk));
+  while (n < 0 && errno == EINTR);
+  if (n > 0) {
+    buf.append(chunk, n);
+    return true;
+  }
+  if (!buf.empty() && buf[buf.size() - 1] != '\n') buf += '\n';
+  return false;
+}
+
+// Move the complete lines of buf, but the empty ones, to lines
+inline void takeLines(std::string &buf, std::vector<std::string> &lines) {
+  size_t start = 0, end;
+  while ((end = buf.find('\n', start)) != std::string::npos) {
+    std::string line = buf.substr(start, end - start);
+    start = end + 1;
+    if (!line.empty() && line[line.size() - 1] == '\r') line.resize(line.size() - 1);
+    if (!line.empty()) lines.push_back(line);
+  }
+  buf.erase(0, start);
+}
+
+// Answer the lines read from in on out until the end of the input; false
+// if a line was "quit"
+template <typename Answer>
+bool serveLines(int in, int out, Answer &answer) {
+  std::string buf, reply;
+  bool open = true;
+  while (open) {
+    open = readChunk(in, buf);
+    std::vector<std::string> lines;
+    takeLines(buf, lines);
+    reply.clear();
+    bool quit = false;
+    for (size_t i = 0; i < lines.size() && !quit; i++)
+      if (lines[i] == "quit")
+        quit = true;
+      else
+        reply += answer(lines[i]) + "\n";
+    if (!writeAll(out, reply) || quit) return !quit;
+  }
+  return true;
+}
+
+// Serve stdin and stdout (path NULL), or the connections to the Unix socket
+// at path, all at once: the lines of the clients with input are one batch,
+// in the order of the clients, and every client gets the answers to its
+// lines. answer(line) is the answer to a query line, without the newline.
+template <typename Answer>
+bool serveQueries(const char *path, Answer answer) {
+  signal(SIGPIPE, SIG_IGN);  // a client may leave before its answers
+  if (path == NULL) {
+    serveLines(0, 1, answer);
+    return true;
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    return false;
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1) {
+    perror("Error creating socket");
+    return false;
+  }
+  unlink(path);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, 16) == -1) {
+    perror("Error binding socket");
+    close(fd);
+    return false;
+  }
+
+  struct Client {
+    int fd;
+    std::string buf;
+  };
+  std::vector<Client> clients;
+  bool serving = true;
+  while (serving) {
+    std::vector<struct pollfd> ready(1);
+    ready[0].fd = fd;
+    ready[0].events = POLLIN;
+    for (const Client &c : clients) {
+      struct pollfd p;
+      p.fd = c.fd;
+      p.events = POLLIN;
+      ready.push_back(p);
+    }
+    if (poll(ready.data(), ready.size(), -1) == -1) {
+      if (errno == EINTR) continue;
+      perror("Error waiting for queries");
+      break;
+    }
+
+    // the batch: the lines of every client with input
+    std::vector<size_t> from;
+    std::vector<std::string> lines;
+    std::vector<char> open(clients.size(), 1);
+    for (size_t i = 0; i < clients.size(); i++) {
+      if (!(ready[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+      open[i] = readChunk(clients[i].fd, clients[i].buf);
+      takeLines(clients[i].buf, lines);
+      from.resize(lines.size(), i);
+    }
+
+    std::vector<std::string> reply(clients.size());
+    for (size_t j = 0; j < lines.size() && serving; j++)
+      if (lines[j] == "quit")
+        serving = false;
+      else
+        reply[from[j]] += answer(lines[j]) + "\n";
+
+    std::vector<Client> still;
+    for (size_t i = 0; i < clients.size(); i++)
+      if (writeAll(clients[i].fd, reply[i]) && open[i] && serving)
+        still.push_back(clients[i]);
+      else
+        close(clients[i].fd);
+    clients.swap(still);
+
+    if (serving && (ready[0].revents & POLLIN)) {
+      int conn = accept(fd, NULL, NULL);
+      if (conn != -1)
+        clients.push_back({conn, std::string()});
+      else if (errno != EINTR) {
+        perror("Error accepting connection");
+        break;
+      }
+    }
+  }
+  for (const Client &c : clients) close(c.fd);
+  close(fd);
+  unlink(path);
+  return serving;
+}
+
+#endif
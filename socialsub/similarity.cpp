@@ -1,5 +1,8 @@
 #include <bits/stdc++.h>
 #include <omp.h>
+#include "../graph_read.hpp"
+#include "../dp_layer.hpp"
+#include "../path_sampler.hpp"
 
 using namespace std;
 
@@ -68,7 +71,7 @@ unsigned int N, E;    // number of nodes, edges
 int label[MAXN];          // id node -> id label
 int color[MAXN];      // id node -> color
 bool in[MAXN];        // id node -> picked in induced subgraph
-vector<int> G[MAXN];  // id node -> { id node neighbour }
+CSRGraph G;           // id node -> { id node neighbour }
 map<int, pair<string, int>> userCatId;  // id node -> <category, id cat>
 
 // COLORSET functions
@@ -89,26 +92,11 @@ vector<int> L(vector<int> P) {
 }
 
 // Color-Coding Dynamic Programming preprocessing
-map<COLORSET, ll> M[MAXQ + 1][MAXN];
+DPLayer<COLORSET> M[MAXQ + 1];
 
 void processDP() {
-  #pragma omp parallel for schedule(guided)
-  for (unsigned int u = 0; u < N; u++) M[1][u][setBit(0, color[u])] = 1ll;
-
-  for (unsigned int i = 2; i <= q; i++) {
-    #pragma omp parallel for schedule(guided)
-    for (unsigned int u = 0; u < N; u++) {
-      for (int v : G[u]) {
-        for (auto d : M[i - 1][v]) {
-          COLORSET s = d.first;
-          ll f = d.second;
-          if (getBit(s, color[u])) continue;
-          ll fp = M[i][u][setBit(s, color[u])];
-          M[i][u][setBit(s, color[u])] = f + fp;
-        }
-      }
-    }
-  }
+  initLayer(M[1], MAXN, color);
+  for (unsigned int i = 2; i <= q; i++) buildLayer(M[i], M[i - 1], MAXN, G, color);
 }
 
 // Definition of Y(x) for facebook' users
@@ -186,22 +174,19 @@ double BCW(set<vector<int>> W, map<vector<int>, ll> freqA, map<vector<int>, ll>
   return (double)num / (double)den;
 }
 
+// Steps of randomPathTo, cached by every thread across the queries (the DP
+// does not change)
+vector<PathSampler> samplers(omp_get_max_threads());
+
 vector<int> randomPathTo(int u) {
   vector<int> P;
   P.push_back(u);
   COLORSET cs = getCompl(setBit(0ll, color[u]));
   mt19937_64 eng = mt19937_64(seed*u);
   for (int qi = q - 1; qi > 0; qi--) {
-    vector<ll> freq;
-    for (int v : G[u])
-    {
-      int add=0;
-      if( M[qi][v].find(cs) != M[qi][v].end() )
-        add = M[qi][v][cs];
-      freq.push_back(add);
-    }
-    discrete_distribution<int> distribution(freq.begin(), freq.end());
-    u = G[u][distribution(eng)];
+    const PathStep &S = samplers[omp_get_thread_num()].step(
+        G, qi, u, cs, [&](int v) { return M[qi].get(v, cs); });
+    u = S.sample(eng);
     P.push_back(u);
     cs = clearBit(cs, color[u]);
   }
@@ -213,7 +198,7 @@ map<pair<int, vector<int>>, ll> randomColorfulSamplePlus(vector<int> X, int r) {
   map<pair<int, vector<int>>, ll> dict;
   set<vector<int>> R;
   vector<ll> freqX;
-  for (int x : X) freqX.push_back(M[q][x][getCompl(0ll)]);
+  for (int x : X) freqX.push_back(M[q].get(x, getCompl(0ll)));
   discrete_distribution<int> distribution(freqX.begin(), freqX.end());
   ll generated = 0;
   mt19937_64 eng = mt19937_64(seed*X[0]);
@@ -417,13 +402,16 @@ int main() {
 
   // Reading edges
   E=0;
+  vector<int> arcs;
   while (!feof(edge)) {
     int x, y;
     assert(2 == fscanf(edge, "%d %d\n", &x, &y));
     if (!in[x] || !in[y]) continue;  // Only edges in induced subgraph
-    G[x].push_back(y);
+    arcs.push_back(x);
+    arcs.push_back(y);
     E++;
   }
+  buildCSR(G, MAXN, arcs, true);
 
   // Preprocessing for approximated queries
   if( !exact )
@@ -0,0 +1,118 @@
+#ifndef _STREAM_SIMILARITY_HPP
+#define _STREAM_SIMILARITY_HPP
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include "qgram.hpp"
+
+// Weighted Bray-Curtis (BCW) and frequency Jaccard (FJW) of A and B over a
+// stream of sampled paths, updated in O(1) per path, with an error bound:
+// K Poisson bootstrap replicates are updated along, every path counted
+// w ~ Poisson(1) times in every replicate (Hanley-MacGibbon). The bound is
+// the normal interval with the standard deviation of the replicates, plus
+// their bias (the min of sampled counts underestimates the min of the
+// frequencies on small samples). The weights are hashed from the path, so
+// the replicates need no storage of the sample and are reproducible.
+class StreamSimilarity {
+  unsigned int K;
+  std::unordered_map<QGram, size_t, QGramHash> label;
+  // Paths of A and B of every label, in replicate k: fa[label * (K + 1) + k]
+  // (replicate 0 is the sample itself)
+  std::vector<long long> fa, fb;
+  // Per replicate: sum over the labels of min(fa, fb), paths of A plus
+  // paths of B, all the paths
+  std::vector<long long> minSum, sumAB, total;
+
+  static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  // Poisson(1) by inversion of a uniform hashed from (h, k)
+  static int poisson(uint64_t h, unsigned int k) {
+    double u = (mix(h + k * 0x9e3779b97f4a7c15ull) >> 11) / 9007199254740992.0;
+    double p = exp(-1.0), cdf = p;
+    int w = 0;
+    while (u > cdf && w < 16) {
+      p /= ++w;
+      cdf += p;
+    }
+    return w;
+  }
+
+  double bc(unsigned int k) const {
+    return sumAB[k] ? 2.0 * minSum[k] / sumAB[k] : 0.0;
+  }
+
+  double fj(unsigned int k) const {
+    return total[k] ? (double)minSum[k] / total[k] : 0.0;
+  }
+
+  // z of the two-sided (1 - delta) normal interval
+  static double z(double delta) {
+    double lo = 0, hi = 40;
+    for (int it = 0; it < 100; it++) {
+      double m = (lo + hi) / 2;
+      if (erfc(m / sqrt(2.0)) > delta)
+        lo = m;
+      else
+        hi = m;
+    }
+    return lo;
+  }
+
+  template <typename Estimate>
+  double halfWidth(double delta, Estimate est) const {
+    if (K < 2) return INFINITY;
+    double mean = 0, var = 0;
+    for (unsigned int k = 1; k <= K; k++) mean += est(k);
+    mean /= K;
+    for (unsigned int k = 1; k <= K; k++) var += (est(k) - mean) * (est(k) - mean);
+    return z(delta) * sqrt(var / (K - 1)) + fabs(mean - est(0));
+  }
+
+ public:
+  StreamSimilarity(unsigned int replicates)
+      : K(replicates), minSum(K + 1, 0), sumAB(K + 1, 0), total(K + 1, 0) {}
+
+  // A sampled path with label l, from a node of A (inA) and/or B (inB); h
+  // is a hash of the path
+  void add(QGram l, bool inA, bool inB, uint64_t h) {
+    size_t i = label.emplace(l, label.size()).first->second;
+    if (fa.size() < (i + 1) * (K + 1)) {
+      fa.resize((i + 1) * (K + 1), 0);
+      fb.resize((i + 1) * (K + 1), 0);
+    }
+    for (unsigned int k = 0; k <= K; k++) {
+      int w = k == 0 ? 1 : poisson(h, k);
+      if (w == 0) continue;
+      long long &a = fa[i * (K + 1) + k], &b = fb[i * (K + 1) + k];
+      long long before = std::min(a, b);
+      if (inA) a += w;
+      if (inB) b += w;
+      minSum[k] += std::min(a, b) - before;
+      sumAB[k] += w * ((int)inA + (int)inB);
+      total[k] += w;
+    }
+  }
+
+  // Distinct labels seen
+  size_t labels() const { return label.size(); }
+
+  double bc() const { return bc(0); }
+  double fj() const { return fj(0); }
+
+  // Error bound of bc() / fj() with confidence 1 - delta
+  double bcHalfWidth(double delta) const {
+    return halfWidth(delta, [&](unsigned int k) { return bc(k); });
+  }
+  double fjHalfWidth(double delta) const {
+    return halfWidth(delta, [&](unsigned int k) { return fj(k); });
+  }
+};
+
+#endif